@@ -23,10 +23,28 @@
 
 #ifdef ENABLE_BROWSER
 
+#include <ctype.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <stdint.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <time.h>
 #include <unistd.h>
+#if USE_OPENMP
+#include <omp.h>
+#endif
+
+#define FILES_PER_ROUND  64
+		/* How many files get searched in between looks at the keyboard. */
+#define ENTRIES_PER_ROUND  1024
+		/* How many directory entries get looked at in such a round, at most. */
+#define MAX_HITS  100000
+		/* After finding this many matching lines, a search in files stops. */
+#define MAX_SHOWN  240
+		/* How many bytes of a matching line get shown, at most. */
+#define MAPPING_SIZE  (1 << 20)
+		/* From this size on, a file gets mapped into memory instead of read. */
 
 static char **filelist = NULL;
 		/* The list of files to display in the file browser. */
@@ -39,6 +57,38 @@ static size_t longest = 0;
 static size_t selected = 0;
 		/* The currently selected filename in the list; zero-based. */
 
+static bool showing_hits = FALSE;
+		/* Whether the list shows the matching lines of a search in files. */
+static hitstruct *hits = NULL;
+		/* Where those matching lines are, in the order of the list. */
+static size_t hit_count = 0, hits_room = 0;
+		/* The number of matching lines, and the room there is for them. */
+static char *sought = NULL;
+		/* The string that is being searched for in files, if any. */
+static bool caseless = FALSE;
+		/* Whether that string is plain ASCII, sought without regard to case. */
+static regex_t *seekers = NULL;
+		/* When not searching for an exact literal: a compiled form of the
+		 * string for each thread, as a thread cannot share it. */
+static int seeker_count = 0;
+		/* The number of those compiled forms. */
+static char **dirs_to_read = NULL;
+		/* The directories whose entries have not been looked at yet. */
+static size_t dirs_count = 0, dirs_room = 0;
+		/* The number of those directories, and the room for them. */
+static DIR *reading = NULL;
+		/* The directory whose entries are being looked at, if any. */
+static char *reading_path = NULL;
+		/* The path of that directory, including a trailing slash. */
+static size_t root_length = 0;
+		/* The length of the path of the directory where the search began. */
+static size_t files_searched = 0;
+		/* The number of files that were searched so far. */
+static time_t last_report = 0;
+		/* When the progress of the search in files was last shown. */
+static hitstruct chosen_hit = {NULL, 0, 0};
+		/* The matching line that was chosen, if any. */
+
 /* Set filelist to the list of files contained in the directory path,
  * set list_length to the number of files in that list, set longest to
  * the width in columns of the longest filename in that list (between 15
@@ -130,6 +180,41 @@ void browser_select_dirname(const char *needle)
 	}
 }
 
+/* Display at most a screenful of the matching lines of a search in files,
+ * one per row, prefixed with their file name and line number. */
+void show_the_hits(void)
+{
+	int row = 0;
+
+	titlebar(present_path);
+	blank_edit();
+
+	for (size_t index = selected - selected % editwinrows;
+					index < list_length && row < editwinrows; index++) {
+		char *disp = display_string(filelist[index], 0, COLS, FALSE, FALSE);
+
+		if (index == selected) {
+			wattron(edit, interface_color_pair[SELECTED_TEXT]);
+			mvwprintw(edit, row, 0, "%*s", COLS, " ");
+		}
+
+		mvwaddstr(edit, row, 0, disp);
+
+		if (index == selected)
+			wattroff(edit, interface_color_pair[SELECTED_TEXT]);
+
+		free(disp);
+		row++;
+	}
+
+	if (ISSET(SHOW_CURSOR)) {
+		wmove(edit, selected % editwinrows, 0);
+		curs_set(1);
+	}
+
+	wnoutrefresh(edit);
+}
+
 /* Display at most a screenful of filenames from the gleaned filelist. */
 void browser_refresh(void)
 {
@@ -140,6 +225,11 @@ void browser_refresh(void)
 	char *info;
 		/* The additional information that we'll display about a file. */
 
+	if (showing_hits) {
+		show_the_hits();
+		return;
+	}
+
 	titlebar(present_path);
 	blank_edit();
 
@@ -270,6 +360,12 @@ void findfile(const char *needle, bool forwards)
 	unsigned stash[sizeof(flags) / sizeof(flags[0])];
 		/* A storage place for the current flag settings. */
 
+	/* When no line matched a search in files, there is nothing to look at. */
+	if (list_length == 0) {
+		not_found_msg(needle);
+		return;
+	}
+
 	/* Save the settings of all flags. */
 	memcpy(stash, flags, sizeof(flags));
 
@@ -318,14 +414,12 @@ void findfile(const char *needle, bool forwards)
 	selected = looking_at;
 }
 
-/* Prepare the prompt and ask the user what to search for; then search for it.
- * If forwards is TRUE, search forward in the list; otherwise, search backward. */
-void search_filename(bool forwards)
+/* Return the last search string between square brackets, for showing
+ * it in a prompt, or an empty string when nothing was searched for yet. */
+char *bracketed_last_search(void)
 {
 	char *thedefault;
-	int response;
 
-	/* If something was searched for before, show it between square brackets. */
 	if (*last_search != '\0') {
 		char *disp = display_string(last_search, 0, COLS / 3, FALSE, FALSE);
 
@@ -337,18 +431,18 @@ void search_filename(bool forwards)
 	} else
 		thedefault = copy_of("");
 
-	/* Now ask what to search for. */
-	response = do_prompt(MWHEREISFILE, "", &search_history,
-						browser_refresh, "%s%s%s", _("Search"),
-						/* TRANSLATORS: A modifier of the Search prompt. */
-						!forwards ? _(" [Backwards]") : "", thedefault);
-	free(thedefault);
+	return thedefault;
+}
 
+/* Handle the answer to a search prompt: return FALSE when the user cancelled
+ * or there is nothing to search for, and otherwise remember the answer. */
+bool take_search_answer(int response)
+{
 	/* If the user cancelled, or typed <Enter> on a blank answer and
 	 * nothing was searched for yet during this session, get out. */
 	if (response == -1 || (response == -2 && *last_search == '\0')) {
 		statusbar(_("Cancelled"));
-		return;
+		return FALSE;
 	}
 
 	/* If the user typed an answer, remember it. */
@@ -359,7 +453,25 @@ void search_filename(bool forwards)
 #endif
 	}
 
-	findfile(last_search, forwards);
+	return TRUE;
+}
+
+/* Prepare the prompt and ask the user what to search for; then search for it.
+ * If forwards is TRUE, search forward in the list; otherwise, search backward. */
+void search_filename(bool forwards)
+{
+	char *thedefault = bracketed_last_search();
+	int response;
+
+	/* Now ask what to search for. */
+	response = do_prompt(MWHEREISFILE, "", &search_history,
+						browser_refresh, "%s%s%s", _("Search"),
+						/* TRANSLATORS: A modifier of the Search prompt. */
+						!forwards ? _(" [Backwards]") : "", thedefault);
+	free(thedefault);
+
+	if (take_search_answer(response))
+		findfile(last_search, forwards);
 }
 
 /* Search again without prompting for the last given search string,
@@ -380,6 +492,465 @@ void research_filename(bool forwards)
 	}
 }
 
+/* Return TRUE when a search in files has not finished yet. */
+bool searching_files(void)
+{
+	return (reading != NULL || dirs_count > 0);
+}
+
+/* Stop any ongoing search in files, and discard its compiled forms. */
+void stop_searching_files(void)
+{
+	if (reading != NULL)
+		closedir(reading);
+	reading = NULL;
+
+	free_chararray(dirs_to_read, dirs_count);
+	dirs_to_read = NULL;
+	dirs_count = 0;
+	dirs_room = 0;
+
+	for (int index = 0; index < seeker_count; index++)
+		regfree(&seekers[index]);
+	free(seekers);
+	seekers = NULL;
+	seeker_count = 0;
+}
+
+/* Stop searching in files, and discard the matching lines that were found.
+ * (The list itself, which holds how they are shown, is freed elsewhere.) */
+void forget_the_hits(void)
+{
+	stop_searching_files();
+
+	for (size_t index = 0; index < hit_count; index++)
+		free(hits[index].filename);
+	free(hits);
+	hits = NULL;
+	hit_count = 0;
+	hits_room = 0;
+
+	showing_hits = FALSE;
+}
+
+/* Return a copy of the given string in which each character that has
+ * a special meaning in an extended regular expression is escaped. */
+char *escaped_for_regex(const char *literal)
+{
+	char *copy = nmalloc(2 * strlen(literal) + 1);
+	char *spot = copy;
+
+	for (; *literal != '\0'; literal++) {
+		if (strchr("\\^$.[]|()*+?{}", *literal) != NULL)
+			*(spot++) = '\\';
+		*(spot++) = *literal;
+	}
+
+	*spot = '\0';
+
+	return copy;
+}
+
+/* Return the first occurrence in the given stretch of text of the sought
+ * string (which is in lowercase), ignoring the case of ASCII letters. */
+const char *caseless_find(const char *text, size_t length)
+{
+	size_t sought_len = strlen(sought);
+	const char *last = text + length - sought_len;
+
+	if (length < sought_len)
+		return NULL;
+
+	for (const char *spot = text; spot <= last; spot++) {
+		size_t index = 0;
+
+		while (index < sought_len && tolower((unsigned char)spot[index]) == sought[index])
+			index++;
+
+		if (index == sought_len)
+			return spot;
+	}
+
+	return NULL;
+}
+
+/* Search the given file for the sought string, using the given compiled form
+ * of it, or (when that is NULL) looking for it as an exact literal.  Skip files
+ * that seem binary.  Return the number of lines that contain a match, and pass
+ * back where these lines are and how they should be shown in the list. */
+size_t search_one_file(const char *path, const regex_t *seeker,
+						hitstruct **found, char ***shown)
+{
+	int fd = open(path, O_RDONLY);
+	size_t count = 0, room = 0, lineno = 1;
+	const char *text, *end, *spot, *counted;
+	char *contents = NULL;
+	struct stat info;
+	off_t size;
+
+	*found = NULL;
+	*shown = NULL;
+
+	if (fd < 0)
+		return 0;
+
+	if (fstat(fd, &info) == -1 || !S_ISREG(info.st_mode) || info.st_size == 0) {
+		close(fd);
+		return 0;
+	}
+
+	size = info.st_size;
+
+	/* Map a large file into memory, reading one byte beyond its end, which
+	 * is a NUL when the last page is not full.  Read other files, as that
+	 * is cheaper for small ones, and add a NUL, for the sake of regexec(). */
+	if (size >= MAPPING_SIZE && size % sysconf(_SC_PAGESIZE) != 0)
+		text = mmap(NULL, size + 1, PROT_READ, MAP_PRIVATE, fd, 0);
+	else {
+		ssize_t got = read(fd, contents = nmalloc(size + 1), size);
+
+		size = (got < 0) ? 0 : got;
+		contents[size] = '\0';
+		text = contents;
+	}
+
+	close(fd);
+
+	if (text == MAP_FAILED)
+		return 0;
+
+	end = text + size;
+	spot = text;
+	counted = text;
+
+	/* A file with a NUL byte near its start is taken to be binary. */
+	if (memchr(text, '\0', (size < 4096) ? size : 4096) != NULL)
+		spot = end;
+
+	while (spot < end && count < MAX_HITS) {
+		const char *match, *newline, *line_end;
+		regmatch_t span;
+		size_t length;
+
+		if (caseless)
+			match = caseless_find(spot, end - spot);
+		else if (seeker == NULL)
+			match = memmem(spot, end - spot, sought, strlen(sought));
+		else {
+			span.rm_so = spot - text;
+			span.rm_eo = end - text;
+			match = (regexec(seeker, text, 1, &span, REG_STARTEND) == 0) ?
+								text + span.rm_so : NULL;
+		}
+
+		if (match == NULL)
+			break;
+
+		/* Count the lines up to the one that contains the match. */
+		while ((newline = memchr(counted, '\n', match - counted)) != NULL) {
+			counted = newline + 1;
+			lineno++;
+		}
+
+		line_end = memchr(match, '\n', end - match);
+		if (line_end == NULL)
+			line_end = end;
+
+		/* As a regex like "[[:space:]]+" can match across a newline, try
+		 * such a match again within the line where it began. */
+		if (seeker != NULL && text + span.rm_eo > line_end) {
+			span.rm_so = match - text;
+			span.rm_eo = line_end - text;
+
+			if (regexec(seeker, text, 1, &span, REG_STARTEND) != 0) {
+				spot = line_end + 1;
+				counted = spot;
+				lineno++;
+				continue;
+			}
+
+			match = text + span.rm_so;
+		}
+
+		if (count == room) {
+			room = 2 * room + 8;
+			*found = nrealloc(*found, room * sizeof(hitstruct));
+			*shown = nrealloc(*shown, room * sizeof(char *));
+		}
+
+		(*found)[count].filename = copy_of(path);
+		(*found)[count].lineno = lineno;
+		(*found)[count].x = match - counted;
+
+		length = line_end - counted;
+		if (length > MAX_SHOWN)
+			length = MAX_SHOWN;
+
+		(*shown)[count] = nmalloc(strlen(path) + length + 24);
+		sprintf((*shown)[count], "%s:%zu: ", path + root_length, lineno);
+		strncat((*shown)[count], counted, length);
+
+		count++;
+
+		/* Continue searching on the next line. */
+		spot = line_end + 1;
+		counted = spot;
+		lineno++;
+	}
+
+	if (contents == NULL)
+		munmap((void *)text, size + 1);
+	else
+		free(contents);
+
+	return count;
+}
+
+/* Look at the next batch of files below the directory where the search in
+ * files began, and add the matching lines in them to the list of hits. */
+void search_some_files(void)
+{
+	char *batch[FILES_PER_ROUND];
+	hitstruct *found[FILES_PER_ROUND];
+	char **shown[FILES_PER_ROUND];
+	size_t counts[FILES_PER_ROUND];
+	int amount = 0, entries = 0;
+
+	/* Gather a batch of regular files, noting any subdirectories. */
+	while (amount < FILES_PER_ROUND && entries++ < ENTRIES_PER_ROUND) {
+		const struct dirent *entry;
+		bool is_dir, is_file;
+		char *path;
+
+		if (reading == NULL) {
+			if (dirs_count == 0)
+				break;
+
+			reading_path = free_and_assign(reading_path, dirs_to_read[--dirs_count]);
+			reading = opendir(reading_path);
+			continue;
+		}
+
+		entry = readdir(reading);
+
+		if (entry == NULL) {
+			closedir(reading);
+			reading = NULL;
+			continue;
+		}
+
+		/* Skip hidden files and directories, and thus also "." and "..". */
+		if (entry->d_name[0] == '.')
+			continue;
+
+		path = nmalloc(strlen(reading_path) + strlen(entry->d_name) + 2);
+		sprintf(path, "%s%s", reading_path, entry->d_name);
+
+#ifdef _DIRENT_HAVE_D_TYPE
+		is_dir = (entry->d_type == DT_DIR);
+		is_file = (entry->d_type == DT_REG);
+
+		if (entry->d_type == DT_UNKNOWN)
+#endif
+		{
+			struct stat info;
+
+			/* Symbolic links are not followed, to avoid going in circles. */
+			is_dir = (lstat(path, &info) == 0 && S_ISDIR(info.st_mode));
+			is_file = (!is_dir && S_ISREG(info.st_mode));
+		}
+
+		if (is_dir) {
+			if (dirs_count == dirs_room) {
+				dirs_room = 2 * dirs_room + 16;
+				dirs_to_read = nrealloc(dirs_to_read, dirs_room * sizeof(char *));
+			}
+
+			strcat(path, "/");
+			dirs_to_read[dirs_count++] = path;
+		} else if (is_file)
+			batch[amount++] = path;
+		else
+			free(path);
+	}
+
+	/* Search the gathered files, spread over the available cores. */
+#if USE_OPENMP
+	#pragma omp parallel for schedule(dynamic)
+#endif
+	for (int index = 0; index < amount; index++) {
+#if USE_OPENMP
+		const regex_t *seeker = (seekers == NULL) ? NULL :
+								&seekers[omp_get_thread_num() % seeker_count];
+#else
+		const regex_t *seeker = seekers;
+#endif
+		counts[index] = search_one_file(batch[index], seeker, &found[index], &shown[index]);
+	}
+
+	/* Add the matching lines to the list, in the order of the batch. */
+	for (int index = 0; index < amount; index++) {
+		for (size_t one = 0; one < counts[index]; one++) {
+			if (hit_count == MAX_HITS) {
+				free(found[index][one].filename);
+				free(shown[index][one]);
+				continue;
+			}
+
+			if (hit_count == hits_room) {
+				hits_room = 2 * hits_room + 64;
+				hits = nrealloc(hits, hits_room * sizeof(hitstruct));
+				filelist = nrealloc(filelist, hits_room * sizeof(char *));
+			}
+
+			hits[hit_count] = found[index][one];
+			filelist[hit_count++] = shown[index][one];
+		}
+
+		free(found[index]);
+		free(shown[index]);
+		free(batch[index]);
+	}
+
+	files_searched += amount;
+	list_length = hit_count;
+
+	if (hit_count == MAX_HITS) {
+		stop_searching_files();
+		statusline(AHEM, _("Stopped after %zu matching lines"), hit_count);
+	} else if (!searching_files()) {
+		stop_searching_files();
+		if (hit_count == 0)
+			not_found_msg(sought);
+		else
+			statusline(REMARK, P_("%zu matching line in %zu files",
+								"%zu matching lines in %zu files", hit_count),
+								hit_count, files_searched);
+	} else if (time(NULL) != last_report) {
+		statusline(INFO, _("Searching... %zu files, %zu matching lines so far"),
+								files_searched, hit_count);
+		last_report = time(NULL);
+	}
+}
+
+/* Search files until a keystroke comes in, showing the matching lines as
+ * they are found.  Return the keystroke, or ERR when the search finished. */
+int search_files_until_keystroke(WINDOW *frame)
+{
+	int input = ERR;
+
+	nodelay(frame, TRUE);
+
+	while (input == ERR && searching_files()) {
+		size_t had = hit_count;
+
+		search_some_files();
+
+		/* Redraw the list when new lines became visible on the screen. */
+		if (had < selected - selected % editwinrows + editwinrows && hit_count > had)
+			browser_refresh();
+
+		doupdate();
+
+		input = wgetch(frame);
+
+		if (the_window_resized) {
+			regenerate_screen();
+			input = KEY_WINCH;
+		}
+	}
+
+	nodelay(frame, FALSE);
+
+	return input;
+}
+
+/* Ask what to search for in the files below the given directory, and start
+ * searching.  Return TRUE when a search was started. */
+bool start_searching_files(const char *path)
+{
+	char *thedefault = bracketed_last_search();
+	int response;
+
+	response = do_prompt(MWHEREISFILE, "", &search_history,
+						browser_refresh, "%s%s%s%s", _("Search in Files"),
+						ISSET(CASE_SENSITIVE) ? _(" [Case Sensitive]") : "",
+						ISSET(USE_REGEXP) ? _(" [Regexp]") : "", thedefault);
+	free(thedefault);
+
+	if (!take_search_answer(response))
+		return FALSE;
+
+	/* Check the validity of a regex, and report when it is bad. */
+	if (ISSET(USE_REGEXP) && !regexp_init(last_search))
+		return FALSE;
+
+	forget_the_hits();
+
+	sought = mallocstrcpy(sought, last_search);
+	caseless = !ISSET(USE_REGEXP) && !ISSET(CASE_SENSITIVE);
+
+	/* An ASCII string can be compared in lowercase, without regard to case. */
+	for (char *letter = sought; caseless && *letter != '\0'; letter++)
+		caseless = ((signed char)*letter >= 0);
+
+	for (char *letter = sought; caseless && *letter != '\0'; letter++)
+		*letter = tolower((unsigned char)*letter);
+
+	/* Otherwise, except for an exact literal, use a regex that keeps
+	 * to single lines. */
+	if (!caseless && (ISSET(USE_REGEXP) || !ISSET(CASE_SENSITIVE))) {
+		char *expression = ISSET(USE_REGEXP) ? copy_of(sought) : escaped_for_regex(sought);
+		int cflags = NANO_REG_EXTENDED | REG_NEWLINE |
+								(ISSET(CASE_SENSITIVE) ? 0 : REG_ICASE);
+#if USE_OPENMP
+		seeker_count = omp_get_max_threads();
+#else
+		seeker_count = 1;
+#endif
+		seekers = nmalloc(seeker_count * sizeof(regex_t));
+
+		for (int index = 0; index < seeker_count; index++)
+			regcomp(&seekers[index], expression, cflags);
+
+		free(expression);
+	}
+
+	dirs_room = 16;
+	dirs_to_read = nmalloc(dirs_room * sizeof(char *));
+	dirs_to_read[dirs_count++] = copy_of(path);
+	root_length = strlen(path);
+
+	free_chararray(filelist, list_length);
+	filelist = NULL;
+	list_length = 0;
+
+	showing_hits = TRUE;
+	files_searched = 0;
+	last_report = 0;
+	selected = 0;
+	longest = COLS;
+	width = 1;
+
+	return TRUE;
+}
+
+/* If the current buffer holds the file of the matching line that was chosen
+ * in the browser, put the cursor at the match. */
+void go_to_chosen_hit(void)
+{
+	if (chosen_hit.filename != NULL && strcmp(openfile->filename, chosen_hit.filename) == 0) {
+		do_gotolinecolumn(chosen_hit.lineno, 1, FALSE, FALSE);
+
+		if (chosen_hit.x < strlen(openfile->current->data))
+			openfile->current_x = chosen_hit.x;
+		openfile->placewewant = xplustabs();
+	}
+
+	free(chosen_hit.filename);
+	chosen_hit.filename = NULL;
+}
+
 /* Strip one element from the end of path, and return the stripped path.
  * The returned string is dynamically allocated, and should be freed. */
 char *strip_last_component(const char *path)
@@ -407,9 +978,16 @@ char *browse(char *path)
 	char *chosen = NULL;
 		/* The name of the file that the user picked, or NULL if none. */
 
+	free(chosen_hit.filename);
+	chosen_hit.filename = NULL;
+
   read_directory_contents:
 		/* We come here when the user refreshes or selects a new directory. */
 
+	/* When the list shows the matching lines of a search, discard them. */
+	if (showing_hits)
+		forget_the_hits();
+
 	path = free_and_assign(path, get_full_path(path));
 
 	if (path != NULL)
@@ -534,6 +1112,9 @@ char *browse(char *path)
 			research_filename(BACKWARD);
 		} else if (func == do_findnext) {
 			research_filename(FORWARD);
+		} else if (func == find_in_files) {
+			if (start_searching_files(path))
+				old_selected = (size_t)-1;
 		} else if (func == do_left) {
 			if (selected > 0)
 				selected--;
@@ -621,6 +1202,16 @@ char *browse(char *path)
 
 			/* Try opening and reading the specified directory. */
 			goto read_directory_contents;
+		} else if (func == do_enter && showing_hits) {
+			if (list_length == 0)
+				continue;
+
+			/* Pick the file of the selected line, and remember the line. */
+			chosen_hit.filename = copy_of(hits[selected].filename);
+			chosen_hit.lineno = hits[selected].lineno;
+			chosen_hit.x = hits[selected].x;
+			chosen = copy_of(hits[selected].filename);
+			break;
 		} else if (func == do_enter) {
 			struct stat st;
 
@@ -668,12 +1259,26 @@ char *browse(char *path)
 		} else if (kbinput == KEY_WINCH) {
 			;  /* Nothing to do. */
 #endif
+		} else if (func == do_exit && showing_hits) {
+			/* Leave the matching lines, and show the directory again. */
+			goto read_directory_contents;
 		} else if (func == do_exit) {
 			break;
 		} else
 			unbound_key(kbinput);
 
+		/* Keep the selection within the list of matching lines. */
+		if (showing_hits && selected >= list_length)
+			selected = (list_length > 0) ? list_length - 1 : 0;
+
 #ifndef NANO_TINY
+		/* A list of matching lines just needs to be redrawn. */
+		if (kbinput == KEY_WINCH && showing_hits) {
+			longest = COLS;
+			old_selected = (size_t)-1;
+			continue;
+		}
+
 		/* If the window resized, refresh the file list. */
 		if (kbinput == KEY_WINCH) {
 			/* Remember the selected file, to be able to reselect it. */
@@ -689,6 +1294,7 @@ char *browse(char *path)
 
 	free(path);
 
+	forget_the_hits();
 	free_chararray(filelist, list_length);
 	filelist = NULL;
 	list_length = 0;
@@ -30,6 +30,10 @@
 
 static bool use_utf8 = FALSE;
 		/* Whether we've enabled UTF-8 support. */
+static char *primed_needle = NULL;
+		/* The needle for which the table below was last filled in. */
+static bool can_begin[256];
+		/* Which bytes can begin a case-insensitive match of that needle. */
 
 /* Enable UTF-8 support. */
 void utf8_init(void)
@@ -460,6 +464,38 @@ int mbstrncasecmp(const char *s1, const char *s2, size_t n)
 		return strncasecmp(s1, s2, n);
 }
 
+#ifdef ENABLE_UTF8
+/* Note in a table which bytes can begin a case-insensitive match of the
+ * given needle, so that a search can skip over all other bytes quickly.
+ * The table is kept until a different needle comes along. */
+void prime_for_needle(const char *needle)
+{
+	wchar_t wc;
+
+	if (primed_needle != NULL && strcmp(primed_needle, needle) == 0)
+		return;
+
+	primed_needle = mallocstrcpy(primed_needle, needle);
+
+	for (int byte = 0; byte < 256; byte++) {
+		/* A byte that is not ASCII might begin a character whose lowercase
+		 * form equals that of the first character of the needle. */
+		if (*needle == '\0' || byte > 0x7F)
+			can_begin[byte] = TRUE;
+		else if ((signed char)*needle >= 0) {
+			if ('A' <= (*needle & 0x5F) && (*needle & 0x5F) <= 'Z')
+				can_begin[byte] = ((byte & 0x5F) == (*needle & 0x5F));
+			else
+				can_begin[byte] = (byte == *needle);
+		} else
+			can_begin[byte] = (mbtowide(&wc, needle) > 0 && towlower(byte) == towlower(wc));
+	}
+
+	/* Let a scan stop also at the end of the string. */
+	can_begin[0] = TRUE;
+}
+#endif
+
 /* This function is equivalent to strcasestr() for multibyte strings. */
 char *mbstrcasestr(const char *haystack, const char *needle)
 {
@@ -467,14 +503,22 @@ char *mbstrcasestr(const char *haystack, const char *needle)
 	if (use_utf8) {
 		size_t needle_len = mbstrlen(needle);
 
-		while (*haystack != '\0') {
+		prime_for_needle(needle);
+
+		while (TRUE) {
+			/* Skip quickly over the ASCII characters that cannot begin a match.
+			 * As other bytes are never skipped, we stay on character starts. */
+			while (!can_begin[(unsigned char)*haystack])
+				haystack++;
+
+			if (*haystack == '\0')
+				return NULL;
+
 			if (mbstrncasecmp(haystack, needle, needle_len) == 0)
 				return (char *)haystack;
 
 			haystack += char_length(haystack);
 		}
-
-		return NULL;
 	} else
 #endif
 		return (char *)strcasestr(haystack, needle);
@@ -492,7 +536,8 @@ char *revstrstr(const char *haystack, const char *needle,
 		pointer += tail_len - needle_len;
 
 	while (pointer >= haystack) {
-		if (strncmp(pointer, needle, needle_len) == 0)
+		/* Compare the first byte in place before comparing the whole needle. */
+		if (*pointer == *needle && strncmp(pointer, needle, needle_len) == 0)
 			return (char *)pointer;
 		pointer--;
 	}
@@ -507,12 +552,14 @@ char *revstrcasestr(const char *haystack, const char *needle,
 {
 	size_t needle_len = strlen(needle);
 	size_t tail_len = strlen(pointer);
+	int first = tolower((unsigned char)*needle);
 
 	if (tail_len < needle_len)
 		pointer += tail_len - needle_len;
 
 	while (pointer >= haystack) {
-		if (strncasecmp(pointer, needle, needle_len) == 0)
+		if (tolower((unsigned char)*pointer) == first &&
+							strncasecmp(pointer, needle, needle_len) == 0)
 			return (char *)pointer;
 		pointer--;
 	}
@@ -536,14 +583,21 @@ char *mbrevstrcasestr(const char *haystack, const char *needle,
 		if (pointer < haystack)
 			return NULL;
 
+		prime_for_needle(needle);
+
 		while (TRUE) {
-			if (mbstrncasecmp(pointer, needle, needle_len) == 0)
+			if (can_begin[(unsigned char)*pointer] &&
+							mbstrncasecmp(pointer, needle, needle_len) == 0)
 				return (char *)pointer;
 
 			if (pointer == haystack)
 				return NULL;
 
-			pointer = haystack + step_left(haystack, pointer - haystack);
+			/* An ASCII byte is always a character by itself. */
+			if ((signed char)pointer[-1] >= 0)
+				pointer--;
+			else
+				pointer = haystack + step_left(haystack, pointer - haystack);
 		}
 	} else
 #endif
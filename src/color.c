@@ -27,7 +27,11 @@
 #ifdef HAVE_MAGIC_H
 #include <magic.h>
 #endif
+#include <stdint.h>
 #include <string.h>
+#if USE_OPENMP
+#include <omp.h>
+#endif
 
 static bool defaults_allowed = FALSE;
 		/* Whether ncurses accepts -1 to mean "default color". */
@@ -234,58 +238,446 @@ void find_and_prime_applicable_syntax(void)
 	openfile->syntax = sntx;
 }
 
+/* The number of multiline regexes whose states fit together into a line. */
+#define PACKED_STATES  21
+
+/* Return the state of the given multiline regex at the given line,
+ * or zero when this state has not been determined. */
+short multistate_of(const linestruct *line, short id)
+{
+	int code;
+
+	/* When the lowest bit is set, the states are packed, three bits each. */
+	if (line->multidata & 1) {
+		code = (line->multidata >> (1 + 3 * id)) & 7;
+		return (code == 0) ? 0 : (1 << code);
+	} else if (line->multidata == 0)
+		return 0;
+	else
+		return ((short *)(uintptr_t)line->multidata)[id];
+}
+
+/* Set the state of the given multiline regex at the given line.  When the
+ * syntax has so many of these regexes that their states don't fit in the
+ * line's field, an array is allocated for them. */
+void set_multistate(linestruct *line, short id, short state)
+{
+	uint64_t code = 0;
+
+	if (line->multidata == 0 && openfile->syntax->nmultis > PACKED_STATES) {
+		short *states = nmalloc(openfile->syntax->nmultis * sizeof(short));
+
+		for (short item = 0; item < openfile->syntax->nmultis; item++)
+			states[item] = 0;
+
+		line->multidata = (uintptr_t)states;
+	}
+
+	if (line->multidata == 0 || (line->multidata & 1)) {
+		/* The states are single bits, so find the position of the bit. */
+		while ((1 << code) < state)
+			code++;
+
+		line->multidata &= ~((uint64_t)7 << (1 + 3 * id));
+		line->multidata |= (code << (1 + 3 * id)) | 1;
+	} else
+		((short *)(uintptr_t)line->multidata)[id] = state;
+}
+
+/* Forget the multiline-regex states of the given line. */
+void discard_multidata(linestruct *line)
+{
+	if (!(line->multidata & 1))
+		free((short *)(uintptr_t)line->multidata);
+
+	line->multidata = 0;
+}
+
 /* Determine whether the matches of multiline regexes are still the same,
- * and if not, schedule a screen refresh, so things will be repainted. */
+ * and if not, bring the multiline info up to date, and schedule a screen
+ * refresh when the info of any line changed. */
 void check_the_multis(linestruct *line)
 {
-	const colortype *ink;
-	bool astart, anend;
+	if (update_the_multis_from(line))
+		refresh_needed = TRUE;
+}
+
+/* Recompute the multiline-regex info of the given line (whose text changed,
+ * as did the text of any directly following lines without multiline info)
+ * and of the lines around it, but only as far as the info is affected: the
+ * recomputing stops at the first unchanged line whose info stays the same.
+ * Return TRUE when the info of any line changed -- a changed state of a line
+ * alters how the next line gets painted, even when the state of that next
+ * line itself stays the same. */
+bool update_the_multis_from(linestruct *line)
+{
+	linestruct *last = line;
+	bool changed = FALSE;
 	regmatch_t startmatch, endmatch;
-	char *afterstart;
 
-	/* If there is no syntax or no multiline regex, there is nothing to do. */
-	if (openfile->syntax == NULL || openfile->syntax->nmultis == 0)
-		return;
+	if (!openfile->syntax || openfile->syntax->nmultis == 0 || ISSET(NO_SYNTAX))
+		return FALSE;
 
-	if (line->multidata == NULL) {
-		refresh_needed = TRUE;
-		return;
-	}
+	/* Find the last line of the changed stretch. */
+	while (last->next != NULL && last->next->multidata == 0)
+		last = last->next;
+
+	for (const colortype *ink = openfile->syntax->color; ink != NULL; ink = ink->next) {
+		linestruct *current = line;
+		bool beyond = FALSE;
+			/* Whether the changed stretch lies fully above the current line. */
+		short previous, state = NOTHING;
 
-	for (ink = openfile->syntax->color; ink != NULL; ink = ink->next) {
-		/* If it's not a multiline regex, skip. */
 		if (ink->end == NULL)
 			continue;
 
-		astart = (regexec(ink->start, line->data, 1, &startmatch, 0) == 0);
-		afterstart = line->data + (astart ? startmatch.rm_eo : 0);
-		anend = (regexec(ink->end, afterstart, 1, &endmatch, 0) == 0);
+		/* An end on a changed line may terminate a start that had no end,
+		 * so then begin recomputing from that start. */
+		for (linestruct *item = line; item != last->next; item = item->next)
+			if (could_match(item->data, ink->endneedle, ink->caseless) &&
+						regexec(ink->end, item->data, 0, NULL, 0) == 0) {
+				while (current->prev != NULL &&
+								multistate_of(current->prev, ink->id) == WOULDBE)
+					current = current->prev;
+				break;
+			}
 
-		/* Check whether the multidata still matches the current situation. */
-		if (line->multidata[ink->id] == NOTHING) {
-			if (!astart)
-				continue;
-		} else if (line->multidata[ink->id] & (WHOLELINE|WOULDBE)) {
-			if (!astart && !anend)
-				continue;
-		} else if (line->multidata[ink->id] == JUSTONTHIS) {
-			if (astart && anend && regexec(ink->start, line->data + endmatch.rm_eo,
-														1, &startmatch, 0) != 0)
-				continue;
-		} else if (line->multidata[ink->id] == STARTSHERE) {
-			if (astart && !anend)
-				continue;
-		} else if (line->multidata[ink->id] == ENDSHERE) {
-			if (!astart && anend)
+		previous = (current->prev == NULL) ? NOTHING :
+									multistate_of(current->prev, ink->id);
+
+		for (; current != NULL; current = current->next) {
+			short was = multistate_of(current, ink->id);
+			int index = 0;
+
+			state = NOTHING;
+
+			/* After a start without any end, nothing matters any more. */
+			if (previous == WOULDBE)
+				state = WOULDBE;
+			else if (previous == STARTSHERE || previous == WHOLELINE) {
+				/* When inside a match, see whether it ends on this line. */
+				if (could_match(current->data, ink->endneedle, ink->caseless) &&
+						regexec(ink->end, current->data, 1, &endmatch, 0) == 0) {
+					state = ENDSHERE;
+					index = endmatch.rm_eo;
+				} else
+					state = WHOLELINE;
+			}
+
+			/* Look for starts, and for the ends that follow them, like in
+			 * precalc_multicolorinfo(). */
+			while (state != WHOLELINE && state != WOULDBE &&
+						could_match(current->data, ink->needle, ink->caseless) &&
+						regexec(ink->start, current->data + index, 1, &startmatch,
+										(index == 0) ? 0 : REG_NOTBOL) == 0) {
+				index += startmatch.rm_eo;
+
+				if (regexec(ink->end, current->data + index, 1, &endmatch,
+										(index == 0) ? 0 : REG_NOTBOL) == 0) {
+					state = JUSTONTHIS;
+
+					index += endmatch.rm_eo;
+
+					/* If the total match has zero length, force an advance. */
+					if (startmatch.rm_eo - startmatch.rm_so + endmatch.rm_eo == 0) {
+						if (current->data[index] == '\0')
+							break;
+						index = step_right(current->data, index);
+					}
+					continue;
+				}
+
+				/* For a start without an end on this line, find out whether an end
+				 * follows -- unless nothing below this line changed, because then
+				 * an earlier finding still holds. */
+				if ((beyond || current == last) && (was == STARTSHERE || was == WOULDBE))
+					state = was;
+				else {
+					linestruct *tailline = current->next;
+
+					while (tailline && (!could_match(tailline->data, ink->endneedle,
+								ink->caseless) || regexec(ink->end, tailline->data,
+											0, NULL, 0) != 0))
+						tailline = tailline->next;
+
+					state = (tailline == NULL) ? WOULDBE : STARTSHERE;
+				}
+				break;
+			}
+
+			set_multistate(current, ink->id, state);
+
+			if (state != was)
+				changed = TRUE;
+
+			/* Once past the changed stretch, an unchanged state means that
+			 * the state entering the next line is the same as before, so
+			 * the lines below are unaffected. */
+			if (current == last)
+				beyond = TRUE;
+			if (beyond && state == was)
+				break;
+
+			previous = state;
+		}
+
+		/* When a match ran on until the end of the buffer, it has no end after
+		 * all, so its start and all lines after it should not get painted. */
+		if (current == NULL && (state == STARTSHERE || state == WHOLELINE)) {
+			for (current = openfile->filebot; current != NULL; current = current->prev) {
+				previous = multistate_of(current, ink->id);
+				set_multistate(current, ink->id, WOULDBE);
+				if (previous != WHOLELINE)
+					break;
+			}
+			changed = TRUE;
+		}
+	}
+
+	return changed;
+}
+
+/* Return TRUE when the given text contains the given needle, or when there
+ * is no needle -- that is: when a regex with this needle could match. */
+bool could_match(const char *text, const char *needle, bool caseless)
+{
+	if (needle == NULL)
+		return TRUE;
+	else if (caseless)
+		return (strcasestr(text, needle) != NULL);
+	else
+		return (strstr(text, needle) != NULL);
+}
+
+/* The number of lines for which the painting by single-line rules is kept. */
+#define PAINT_CACHE_SIZE  256
+
+static paintstruct paint_cache[PAINT_CACHE_SIZE];
+		/* The painting of recently drawn lines. */
+
+/* Return the spans that the single-line rules of the current syntax paint
+ * on the given line, complete for at least the part before reach.  Unless
+ * the line or the syntax has changed, the remembered spans are reused, so
+ * that redrawing a line does not need to run any single-line regex. */
+const paintstruct *paint_of(const linestruct *line, size_t reach)
+{
+	paintstruct *paint = &paint_cache[((uintptr_t)line / sizeof(linestruct)) %
+														PAINT_CACHE_SIZE];
+	size_t length = strlen(line->data);
+	size_t goal = reach;
+	regmatch_t match;
+
+	if (paint->line == line && paint->syntax == openfile->syntax &&
+						strcmp(paint->text, line->data) == 0) {
+		if (paint->reach >= reach)
+			return paint;
+		/* Look twice as far as before, to not rescan a long line too often. */
+		if (goal < 2 * paint->reach)
+			goal = 2 * paint->reach;
+	} else {
+		paint->line = line;
+		paint->syntax = openfile->syntax;
+		paint->text = free_and_assign(paint->text, copy_of(line->data));
+	}
+
+	paint->count = 0;
+
+	for (const colortype *varnish = openfile->syntax->color; varnish != NULL;
+												varnish = varnish->next) {
+		size_t index = 0;
+
+		/* Skip multiline rules, and rules whose needle is absent. */
+		if (varnish->end != NULL || !could_match(line->data, varnish->needle,
+												varnish->caseless))
+			continue;
+
+		while (index < goal) {
+			/* If there is no further match, this rule is done. */
+			if (regexec(varnish->start, &line->data[index], 1,
+						&match, (index == 0) ? 0 : REG_NOTBOL) != 0)
+				break;
+
+			/* Translate the match to the beginning of the line. */
+			match.rm_so += index;
+			match.rm_eo += index;
+			index = match.rm_eo;
+
+			/* If the match lies beyond the part wanted, this rule is done. */
+			if (match.rm_so >= goal)
+				break;
+
+			/* If the match has length zero, advance over it. */
+			if (match.rm_so == match.rm_eo) {
+				if (line->data[index] == '\0')
+					break;
+				index = step_right(line->data, index);
 				continue;
+			}
+
+			if (paint->count == paint->room) {
+				paint->room = 2 * paint->room + 16;
+				paint->spans = nrealloc(paint->spans, paint->room * sizeof(spanstruct));
+			}
+
+			paint->spans[paint->count].rule = varnish;
+			paint->spans[paint->count].start = match.rm_so;
+			paint->spans[paint->count].end = match.rm_eo;
+			paint->count++;
 		}
+	}
 
-		/* There is a mismatch, so something changed: repaint. */
-		refresh_needed = TRUE;
-		return;
+	/* When the whole line was covered, any later request can be served. */
+	paint->reach = (goal >= length) ? HIGHEST_POSITIVE : goal;
+
+	return paint;
+}
+
+#if USE_OPENMP
+/* The number of lines from which on the precalculation is spread over cores. */
+#define PARALLEL_PRECALC_LINES  20000
+
+/* What a scan of a line for the starts and ends of a multiline rule found. */
+#define NO_START     0
+#define ONLY_PAIRS   1
+#define OPEN_START   2
+
+/* Scan the given text from the given index onward for starts of the given
+ * rule and for the ends that follow them, using the given copies of its
+ * regexes.  Return whether no start, only complete start-end pairs, or a
+ * start without an end was found. */
+char scan_for_starts(const char *text, int index, const colortype *ink,
+						const regex_t *start, const regex_t *end)
+{
+	regmatch_t startmatch, endmatch;
+	char outcome = NO_START;
+
+	if (!could_match(text, ink->needle, ink->caseless))
+		return NO_START;
+
+	while (regexec(start, text + index, 1, &startmatch,
+								(index == 0) ? 0 : REG_NOTBOL) == 0) {
+		index += startmatch.rm_eo;
+
+		if (regexec(end, text + index, 1, &endmatch,
+								(index == 0) ? 0 : REG_NOTBOL) != 0)
+			return OPEN_START;
+
+		outcome = ONLY_PAIRS;
+		index += endmatch.rm_eo;
+
+		/* If the total match has zero length, force an advance. */
+		if (startmatch.rm_eo - startmatch.rm_so + endmatch.rm_eo == 0) {
+			if (text[index] == '\0')
+				break;
+			index = step_right(text, index);
+		}
 	}
+
+	return outcome;
 }
 
+/* Compute the same multiline-regex info as precalc_multicolorinfo(), but
+ * spread the bulk of the work over the available cores.  The buffer is cut
+ * into regions, and for each combination of multiline rule and region, a
+ * thread notes for each line what a scan for starts (and ends) finds in it.
+ * Then, for each rule, a single pass strings these findings together,
+ * looking for ends only on the lines that lie inside a match.  As the
+ * states of all rules are packed together per line, they are stored
+ * into the lines only at the end. */
+void precalc_multicolorinfo_in_parallel(void)
+{
+	size_t count = openfile->totlines;
+	short nmultis = openfile->syntax->nmultis;
+	int regions = omp_get_max_threads();
+	linestruct **lines = nmalloc(count * sizeof(linestruct *));
+	const colortype **inks = nmalloc(nmultis * sizeof(colortype *));
+	char *findings = nmalloc(nmultis * count);
+	size_t index = 0;
+
+	for (linestruct *line = openfile->filetop; line != NULL; line = line->next)
+		lines[index++] = line;
+
+	for (const colortype *ink = openfile->syntax->color; ink != NULL; ink = ink->next)
+		if (ink->end != NULL)
+			inks[ink->id] = ink;
+
+	#pragma omp parallel for schedule(dynamic)
+	for (int task = 0; task < nmultis * regions; task++) {
+		const colortype *ink = inks[task / regions];
+		int flags = NANO_REG_EXTENDED | (ink->caseless ? REG_ICASE : 0);
+		size_t first = count * (task % regions) / regions;
+		size_t beyond = count * (task % regions + 1) / regions;
+		char *found = findings + (task / regions) * count;
+		regex_t start, end;
+
+		/* Concurrent matchings against a single regex get serialized,
+		 * so each task works with its own copies of the regexes. */
+		regcomp(&start, ink->expression, flags);
+		regcomp(&end, ink->endexpression, flags);
+
+		for (size_t item = first; item < beyond; item++)
+			found[item] = scan_for_starts(lines[item]->data, 0, ink, &start, &end);
+
+		regfree(&start);
+		regfree(&end);
+	}
+
+	/* The rules use different regexes, so they can be stitched concurrently. */
+	#pragma omp parallel for
+	for (short id = 0; id < nmultis; id++) {
+		const colortype *ink = inks[id];
+		char *found = findings + id * count;
+		regmatch_t endmatch;
+		size_t opener = 0;
+		bool inside = FALSE;
+
+		for (size_t item = 0; item < count; item++) {
+			const char *text = lines[item]->data;
+			short state = NOTHING;
+			char outcome = found[item];
+
+			/* When inside a match, see whether it ends on this line,
+			 * and if so, what comes after the end. */
+			if (inside) {
+				if (!could_match(text, ink->endneedle, ink->caseless) ||
+							regexec(ink->end, text, 1, &endmatch, 0) != 0) {
+					found[item] = WHOLELINE;
+					continue;
+				}
+				state = ENDSHERE;
+				outcome = scan_for_starts(text, endmatch.rm_eo, ink, ink->start, ink->end);
+				inside = FALSE;
+			}
+
+			if (outcome == ONLY_PAIRS)
+				state = JUSTONTHIS;
+			else if (outcome == OPEN_START) {
+				state = STARTSHERE;
+				inside = TRUE;
+				opener = item;
+			}
+
+			found[item] = state;
+		}
+
+		/* When the last start has no end, its line and all after it
+		 * would get painted if an end appeared -- but for now none do. */
+		if (inside)
+			for (size_t item = opener; item < count; item++)
+				found[item] = WOULDBE;
+	}
+
+	#pragma omp parallel for
+	for (size_t item = 0; item < count; item++)
+		for (short id = 0; id < nmultis; id++)
+			set_multistate(lines[item], id, findings[id * count + item]);
+
+	free(findings);
+	free(inks);
+	free(lines);
+}
+#endif
+
 /* Precalculate the multi-line start and end regex info so we can
  * speed up rendering (with any hope at all...). */
 void precalc_multicolorinfo(void)
@@ -303,11 +695,12 @@ void precalc_multicolorinfo(void)
 	clock_t start = clock();
 #endif
 
-	/* For each line, allocate cache space for the multiline-regex info. */
-	for (line = openfile->filetop; line != NULL; line = line->next)
-		if (!line->multidata)
-			line->multidata = nmalloc(openfile->syntax->nmultis * sizeof(short));
-
+#if USE_OPENMP
+	/* For a large buffer, let all available cores share the work. */
+	if (openfile->totlines >= PARALLEL_PRECALC_LINES && omp_get_max_threads() > 1)
+		precalc_multicolorinfo_in_parallel();
+	else
+#endif
 	for (ink = openfile->syntax->color; ink != NULL; ink = ink->next) {
 		/* If this is not a multi-line regex, skip it. */
 		if (ink->end == NULL)
@@ -317,7 +710,11 @@ void precalc_multicolorinfo(void)
 			int index = 0;
 
 			/* Assume nothing applies until proven otherwise below. */
-			line->multidata[ink->id] = NOTHING;
+			set_multistate(line, ink->id, NOTHING);
+
+			/* When the line lacks what a start match needs, it is done. */
+			if (!could_match(line->data, ink->needle, ink->caseless))
+				continue;
 
 			/* When the line contains a start match, look for an end,
 			 * and if found, mark all the lines that are affected. */
@@ -330,7 +727,7 @@ void precalc_multicolorinfo(void)
 				 * but continue looking for other starts after it. */
 				if (regexec(ink->end, line->data + index, 1, &endmatch,
 										(index == 0) ? 0 : REG_NOTBOL) == 0) {
-					line->multidata[ink->id] = JUSTONTHIS;
+					set_multistate(line, ink->id, JUSTONTHIS);
 
 					index += endmatch.rm_eo;
 
@@ -348,26 +745,27 @@ void precalc_multicolorinfo(void)
 				/* Look for an end match on later lines. */
 				tailline = line->next;
 
-				while (tailline && regexec(ink->end, tailline->data,
-											1, &endmatch, 0) != 0)
+				while (tailline && (!could_match(tailline->data, ink->endneedle,
+								ink->caseless) || regexec(ink->end, tailline->data,
+											1, &endmatch, 0) != 0))
 					tailline = tailline->next;
 
 				/* When there is no end match, mark relevant lines as such. */
 				if (tailline == NULL) {
 					for (; line->next != NULL; line = line->next)
-						line->multidata[ink->id] = WOULDBE;
-					line->multidata[ink->id] = WOULDBE;
+						set_multistate(line, ink->id, WOULDBE);
+					set_multistate(line, ink->id, WOULDBE);
 					break;
 				}
 
 				/* We found it, we found it, la lala lala.  Mark the lines. */
-				line->multidata[ink->id] = STARTSHERE;
+				set_multistate(line, ink->id, STARTSHERE);
 
 				// Note that this also advances the line in the main loop.
 				for (line = line->next; line != tailline; line = line->next)
-					line->multidata[ink->id] = WHOLELINE;
+					set_multistate(line, ink->id, WHOLELINE);
 
-				tailline->multidata[ink->id] = ENDSHERE;
+				set_multistate(tailline, ink->id, ENDSHERE);
 
 				/* Look for a possible new start after the end match. */
 				index = endmatch.rm_eo;
@@ -43,20 +43,22 @@ void do_deletion(undo_type action)
 		/* If the type of action changed or the cursor moved to a different
 		 * line, create a new undo item, otherwise update the existing item. */
 		if (action != openfile->last_action ||
-					openfile->current->lineno != openfile->current_undo->head_lineno)
+					lineno_of(openfile->current) != openfile->current_undo->head_lineno)
 			add_undo(action, NULL);
 		else
 			update_undo(action);
 #endif
 		/* Move the remainder of the line "in", over the current character. */
+		make_text_private(openfile->current);
 		memmove(&openfile->current->data[openfile->current_x],
 					&openfile->current->data[openfile->current_x + charlen],
 					line_len - charlen + 1);
+		forget_the_counts_of(openfile->current);
 #ifndef NANO_TINY
 		/* When softwrapping, recompute the number of chunks in the line,
 		 * and schedule a refresh if the number changed. */
 		if (ISSET(SOFTWRAP)) {
-			openfile->current->extrarows = extra_chunks_in(openfile->current);
+			compute_the_extra_rows_of(openfile->current);
 			if (openfile->current->extrarows != old_amount)
 				refresh_needed = TRUE;
 		}
@@ -95,12 +97,17 @@ void do_deletion(undo_type action)
 		openfile->current->data = nrealloc(openfile->current->data,
 				strlen(openfile->current->data) + strlen(joining->data) + 1);
 		strcat(openfile->current->data, joining->data);
+		forget_the_counts_of(openfile->current);
 
+#ifndef NANO_TINY
+		discount_the_extra_rows(joining, joining);
+#endif
 		unlink_node(joining);
+		openfile->totlines--;
 
 #ifndef NANO_TINY
 		if (ISSET(SOFTWRAP))
-			openfile->current->extrarows = extra_chunks_in(openfile->current);
+			compute_the_extra_rows_of(openfile->current);
 #endif
 		/* Two lines were joined, so do a renumbering and refresh the screen. */
 		renumber_from(openfile->current);
@@ -261,11 +268,11 @@ void chop_next_word(void)
 void extract_segment(linestruct *top, size_t top_x, linestruct *bot, size_t bot_x)
 {
 	linestruct *taken, *last;
-	bool edittop_inside = (openfile->edittop->lineno >= top->lineno &&
-							openfile->edittop->lineno <= bot->lineno);
+	bool edittop_inside = (lineno_of(openfile->edittop) >= lineno_of(top) &&
+							lineno_of(openfile->edittop) <= lineno_of(bot));
 #ifndef NANO_TINY
 	bool same_line = (openfile->mark == top);
-	bool post_marked = (openfile->mark && (openfile->mark->lineno > top->lineno ||
+	bool post_marked = (openfile->mark && (lineno_of(openfile->mark) > lineno_of(top) ||
 						(same_line && openfile->mark_x > top_x)));
 	bool was_anchored = top->has_anchor;
 
@@ -277,13 +284,21 @@ void extract_segment(linestruct *top, size_t top_x, linestruct *bot, size_t bot_
 			was_anchored |= line->has_anchor;
 #endif
 
+	/* The lines after top up to and including bot will be gone. */
+	openfile->totlines -= lineno_of(bot) - lineno_of(top);
+
 	if (top == bot) {
 		taken = make_new_node(NULL);
 		taken->data = measured_copy(top->data + top_x, bot_x - top_x);
+		make_text_private(top);
 		memmove(top->data + top_x, top->data + bot_x,
 										strlen(top->data + bot_x) + 1);
+		forget_the_counts_of(top);
 		last = taken;
 	} else if (top_x == 0 && bot_x == 0) {
+#ifndef NANO_TINY
+		discount_the_extra_rows(top, bot->prev);
+#endif
 		taken = top;
 		last = make_new_node(NULL);
 		last->data = copy_of("");
@@ -300,6 +315,9 @@ void extract_segment(linestruct *top, size_t top_x, linestruct *bot, size_t bot_
 
 		openfile->current = bot;
 	} else {
+#ifndef NANO_TINY
+		discount_the_extra_rows(top->next, bot);
+#endif
 		taken = make_new_node(NULL);
 		taken->data = copy_of(top->data + top_x);
 		taken->next = top->next;
@@ -311,10 +329,13 @@ void extract_segment(linestruct *top, size_t top_x, linestruct *bot, size_t bot_
 
 		top->data = nrealloc(top->data, top_x + strlen(bot->data + bot_x) + 1);
 		strcpy(top->data + top_x, bot->data + bot_x);
+		forget_the_counts_of(top);
 
 		last = bot;
+		make_text_private(last);
 		last->data[bot_x] = '\0';
 		last->next = NULL;
+		forget_the_counts_of(last);
 
 		openfile->current = top;
 	}
@@ -331,6 +352,7 @@ void extract_segment(linestruct *top, size_t top_x, linestruct *bot, size_t bot_
 		cutbottom->data = nrealloc(cutbottom->data,
 							strlen(cutbottom->data) + strlen(taken->data) + 1);
 		strcat(cutbottom->data, taken->data);
+		forget_the_counts_of(cutbottom);
 
 		cutbottom->next = taken->next;
 		delete_node(taken);
@@ -347,7 +369,7 @@ void extract_segment(linestruct *top, size_t top_x, linestruct *bot, size_t bot_
 	openfile->current->has_anchor = was_anchored;
 
 	if (ISSET(SOFTWRAP))
-		openfile->current->extrarows = extra_chunks_in(openfile->current);
+		compute_the_extra_rows_of(openfile->current);
 
 	if (post_marked || same_line)
 		openfile->mark = openfile->current;
@@ -384,8 +406,11 @@ void ingraft_buffer(linestruct *topline)
 #endif
 	linestruct *botline = topline;
 
-	while (botline->next != NULL)
+	/* Find the end of the graft, and count the lines that it adds. */
+	while (botline->next != NULL) {
 		botline = botline->next;
+		openfile->totlines++;
+	}
 
 	/* Add the size of the text to be grafted to the buffer size. */
 	openfile->totsize += number_of_characters_in(topline, botline);
@@ -403,12 +428,13 @@ void ingraft_buffer(linestruct *topline)
 	if (topline != botline) {
 #ifndef NANO_TINY
 		/* First compute the softwrapped chunks for each line in the graft. */
-		compute_the_extra_rows_per_line_from(topline);
+		compute_the_extra_rows_per_line_from(topline->next);
 #endif
 		/* When inserting at end-of-buffer, update the relevant pointer. */
 		if (line->next == NULL)
 			openfile->filebot = botline;
 
+		make_text_private(line);
 		line->data[xpos + extralen] = '\0';
 
 		/* Hook the grafted lines in after the current one. */
@@ -430,6 +456,10 @@ void ingraft_buffer(linestruct *topline)
 	} else
 		openfile->current_x += extralen;
 
+	/* The text of the current line and of the last grafted line changed. */
+	forget_the_counts_of(line);
+	forget_the_counts_of(openfile->current);
+
 #ifndef NANO_TINY
 	/* When needed, update the mark's pointer and position. */
 	if (mark_follows && topline != botline) {
@@ -439,8 +469,8 @@ void ingraft_buffer(linestruct *topline)
 		openfile->mark_x += extralen;
 
 	if (ISSET(SOFTWRAP)) {
-		line->extrarows = extra_chunks_in(line);
-		openfile->current->extrarows = extra_chunks_in(openfile->current);
+		compute_the_extra_rows_of(line);
+		compute_the_extra_rows_of(openfile->current);
 	}
 #endif
 
@@ -624,6 +654,9 @@ void copy_marked_region(void)
 	/* Make the area that was marked look like a separate buffer. */
 	afterline = botline->next;
 	botline->next = NULL;
+	/* The copy may share the text of the last line, so make that private
+	 * before it gets truncated. */
+	make_text_private(botline);
 	saved_byte = botline->data[bot_x];
 	botline->data[bot_x] = '\0';
 	was_datastart = topline->data;
@@ -635,6 +668,13 @@ void copy_marked_region(void)
 	topline->data = was_datastart;
 	botline->data[bot_x] = saved_byte;
 	botline->next = afterline;
+
+	/* The first and last lines of the copy hold only part of their originals,
+	 * so the counts that were copied along do not apply to them. */
+	forget_the_counts_of(cutbuffer);
+	for (afterline = cutbuffer; afterline->next != NULL; afterline = afterline->next)
+		;
+	forget_the_counts_of(afterline);
 }
 
 /* Copy text from the current buffer into the cutbuffer.  The text is either
@@ -668,7 +708,7 @@ void copy_text(void)
 	}
 
 	addition = make_new_node(NULL);
-	addition->data = copy_of(openfile->current->data + from_x);
+	addition->data = share_data(openfile->current->data + from_x);
 
 	if (ISSET(CUT_FROM_CURSOR))
 		sans_newline = !at_eol;
@@ -716,7 +756,7 @@ void copy_text(void)
 /* Copy text from the cutbuffer into the current buffer. */
 void paste_text(void)
 {
-	ssize_t was_lineno = openfile->current->lineno;
+	ssize_t was_lineno = lineno_of(openfile->current);
 		/* The line number where we started the paste. */
 	size_t was_leftedge = 0;
 		/* The leftedge where we started the paste. */
@@ -744,9 +784,10 @@ void paste_text(void)
 	/* If we pasted less than a screenful, don't center the cursor. */
 	if (less_than_a_screenful(was_lineno, was_leftedge))
 		focusing = FALSE;
+
 #ifdef ENABLE_COLOR
-	else
-		precalc_multicolorinfo();
+	/* Bring the multiline info of the pasted lines and below up to date. */
+	update_the_multis_from(line_from_number(was_lineno));
 #endif
 
 	/* Set the desired x position to where the pasted text ends. */
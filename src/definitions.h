@@ -53,6 +53,7 @@
 #include <dirent.h>
 #include <regex.h>
 #include <signal.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <sys/stat.h>
 
@@ -282,7 +283,7 @@ typedef enum {
 #ifdef ENABLE_COMMENT
 	COMMENT, UNCOMMENT, PREFLIGHT,
 #endif
-	ZAP, CUT, CUT_TO_EOF, COPY, PASTE, INSERT,
+	ZAP, CUT, CUT_TO_EOF, COPY, PASTE, INSERT, REPLACE_ALL,
 	COUPLE_BEGIN, COUPLE_END, OTHER
 } undo_type;
 
@@ -372,6 +373,18 @@ typedef struct colortype {
 		/* The compiled regular expression for 'start=', or the only one. */
 	regex_t *end;
 		/* The compiled regular expression for 'end=', if any. */
+	char *needle;
+		/* A literal that every match of 'start=' contains, or NULL. */
+	char *endneedle;
+		/* A literal that every match of 'end=' contains, or NULL. */
+	bool caseless;
+		/* Whether the regexes (and thus the needles) ignore case. */
+#if USE_OPENMP
+	char *expression;
+		/* The text of 'start=' of a multiline rule, for compiling copies. */
+	char *endexpression;
+		/* The text of 'end=' of a multiline rule, for compiling copies. */
+#endif
 	struct colortype *next;
 		/* Next color combination. */
 } colortype;
@@ -449,7 +462,15 @@ typedef struct linestruct {
 		/* The text of this line. */
 	ssize_t lineno;
 		/* The number of this line. */
+	int charcount;
+		/* The number of characters in this line, or -1 when not known. */
 #ifndef NANO_TINY
+	int wordcount;
+		/* The number of words in this line, or -1 when not known. */
+	int depthchange;
+		/* How much this line changes the depth of the indexed bracket pair. */
+	int lowestdepth;
+		/* The lowest such depth in this line relative to its start, or 1. */
 	ssize_t extrarows;
 		/* The extra rows that this line occupies when softwrapping. */
 #endif
@@ -458,15 +479,57 @@ typedef struct linestruct {
 	struct linestruct *prev;
 		/* Previous node. */
 #ifdef ENABLE_COLOR
-	short *multidata;
-		/* Array of which multi-line regexes apply to this line. */
+	uint64_t multidata;
+		/* Which multi-line regexes apply to this line: either the states
+		 * packed together, or (for many regexes) a pointer to an array. */
 #endif
 #ifndef NANO_TINY
 	bool has_anchor;
 		/* Whether the user has placed an anchor at this line. */
+	int countedcols;
+		/* The width of the edit window when the extra rows were counted. */
 #endif
 } linestruct;
 
+#ifdef ENABLE_COLOR
+typedef struct spanstruct {
+	const colortype *rule;
+		/* The single-line rule that paints this span. */
+	size_t start;
+		/* Where in the line the span begins. */
+	size_t end;
+		/* Where in the line the span ends. */
+} spanstruct;
+
+typedef struct paintstruct {
+	const linestruct *line;
+		/* The line whose painting by single-line rules is remembered. */
+	const syntaxtype *syntax;
+		/* The syntax whose rules were applied to the line. */
+	char *text;
+		/* A copy of the text of the line at that time. */
+	size_t reach;
+		/* Up to where in the line the spans are complete. */
+	spanstruct *spans;
+		/* The spans that the rules paint, in the order of the rules. */
+	size_t count;
+		/* The number of spans in the above array. */
+	size_t room;
+		/* The number of spans that the above array has room for. */
+} paintstruct;
+#endif
+
+typedef struct arenachunk {
+	char *start;
+		/* The beginning of the memory of this chunk. */
+	char *end;
+		/* The first byte after the memory of this chunk. */
+	char *filled;
+		/* Where the next piece of line text will be placed. */
+	size_t users;
+		/* The number of lines whose text lives in this chunk. */
+} arenachunk;
+
 #ifndef NANO_TINY
 typedef struct groupstruct {
 	ssize_t top_line;
@@ -490,6 +553,12 @@ typedef struct undostruct {
 		/* The x position where the operation began or ended. */
 	char *strdata;
 		/* String data to help restore the affected line. */
+	size_t datalength;
+		/* The length of the above string, for a run of typing or deleting. */
+	size_t dataroom;
+		/* The number of bytes allocated for the string, spare ones included. */
+	size_t dataslack;
+		/* The number of spare bytes in front of the string. */
 	size_t wassize;
 		/* The file size before the action. */
 	size_t newsize;
@@ -502,11 +571,46 @@ typedef struct undostruct {
 		/* Mostly the line number of the current line; sometimes something else. */
 	size_t tail_x;
 		/* The x position corresponding to the above line number. */
+	off_t spilled_at;
+		/* Where the bulky data of this item sits in the spill file, or -1. */
+	size_t weight;
+		/* The number of bytes for which this item counts in the undo weight. */
 	struct undostruct *next;
 		/* A pointer to the undo item of the preceding action. */
 } undostruct;
+
+typedef struct matchstruct {
+	linestruct *line;
+		/* The line in which a match of the search string starts. */
+	size_t x;
+		/* The position in that line where the match starts. */
+	size_t length;
+		/* The length of the match. */
+} matchstruct;
 #endif /* !NANO_TINY */
 
+typedef struct regexcachestruct {
+	char *pattern;
+		/* The regular expression as given, or NULL for an unused slot. */
+	int cflags;
+		/* The flags with which it was compiled. */
+	regex_t compiled;
+		/* The compiled form of the expression. */
+	size_t last_use;
+		/* When the compiled form was last asked for. */
+} regexcachestruct;
+
+#ifdef ENABLE_BROWSER
+typedef struct hitstruct {
+	char *filename;
+		/* The full path of the file in which the hit occurs. */
+	size_t lineno;
+		/* The number of the line that contains the hit. */
+	size_t x;
+		/* The position in that line where the match starts. */
+} hitstruct;
+#endif
+
 #ifdef ENABLE_HISTORIES
 typedef struct poshiststruct {
 	char *filename;
@@ -520,6 +624,41 @@ typedef struct poshiststruct {
 } poshiststruct;
 #endif
 
+#ifdef ENABLE_WORDCOMPLETION
+typedef struct wordstruct {
+	char *text;
+		/* The word itself. */
+	size_t length;
+		/* Its length in bytes. */
+	size_t count;
+		/* How often it occurs in all open buffers together. */
+	size_t stamp;
+		/* The completion attempt at which it was last seen in a changed line. */
+} wordstruct;
+
+typedef struct linewordsstruct {
+	const linestruct *line;
+		/* The line whose words are recorded. */
+	size_t fingerprint;
+		/* A hash of the text that the line had when its words were recorded. */
+	wordstruct **words;
+		/* The words that occur in the line, each occurrence separately. */
+	size_t count;
+		/* The number of the above words. */
+} linewordsstruct;
+
+typedef struct wordindexstruct {
+	size_t version;
+		/* The version of the buffer at the time its words were recorded. */
+	linewordsstruct *lines;
+		/* The recorded lines, in the order in which they were in the buffer. */
+	size_t count;
+		/* The number of recorded lines. */
+	size_t room;
+		/* The number of records that the above array has room for. */
+} wordindexstruct;
+#endif
+
 typedef struct openfilestruct {
 	char *filename;
 		/* The file's name. */
@@ -533,6 +672,8 @@ typedef struct openfilestruct {
 		/* The current line for this file. */
 	size_t totsize;
 		/* The file's total number of characters. */
+	ssize_t totlines;
+		/* The file's total number of lines. */
 	size_t firstcolumn;
 		/* The starting column of the top line of the edit window.
 		 * When not in softwrap mode, it's always zero. */
@@ -567,9 +708,63 @@ typedef struct openfilestruct {
 		/* The undo item at which the file was last saved. */
 	undo_type last_action;
 		/* The type of the last action the user performed. */
-#endif
+	size_t undoweight;
+		/* The number of bytes taken up by the undo items held in memory. */
+#endif
+	linestruct **lineindex;
+		/* Every INDEX_STRIDE-th line of the file, for finding lines by number. */
+	size_t indexed;
+		/* The number of valid entries at the start of the above array. */
+	size_t indexsize;
+		/* The number of entries that the above array has room for. */
+#ifndef NANO_TINY
+	size_t *rowsbefore;
+		/* For each entry in the line index, the extra rows of the lines before it. */
+	size_t rowsindexed;
+		/* The number of valid entries at the start of the above array. */
+	size_t extrasum;
+		/* The extra rows that the counted lines of the buffer need in total. */
+	bool chunkscounted;
+		/* Whether the softwrapped chunks of all lines have been counted. */
+#endif
+	size_t *charsbefore;
+		/* For each entry in the line index, the characters of the lines before it. */
+	size_t charsindexed;
+		/* The number of valid entries at the start of the above array. */
+#ifndef NANO_TINY
+	size_t *wordsbefore;
+		/* For each entry in the line index, the words of the lines before it. */
+	size_t wordsindexed;
+		/* The number of valid entries at the start of the above array. */
+	char *depthpair;
+		/* The opening and closing bracket that the depths below are about. */
+	ssize_t *depthbefore;
+		/* For each entry in the line index, the bracket depth at that line. */
+	ssize_t **lowestdepth;
+		/* Per level k, the lowest depth in each run of 2^k index stretches. */
+	size_t depthroom;
+		/* The number of entries that each of the above arrays has room for. */
+	int depthlevels;
+		/* The number of levels that the above table has. */
+	size_t depthsindexed;
+		/* The number of index stretches whose depths are known. */
+#endif
+	ssize_t unnumbered;
+		/* The first line number from where stored numbers may be wrong, or 0. */
 	bool modified;
 		/* Whether the file has been modified. */
+	size_t version;
+		/* Bumped each time the contents of the buffer change. */
+#ifdef ENABLE_WORDCOMPLETION
+	wordindexstruct *words;
+		/* The words in the buffer, as recorded for completing a word. */
+#endif
+#ifdef ENABLE_YCMD
+	size_t ycmd_parsed_version;
+		/* The version for which ycmd last got a FileReadyToParse. */
+	size_t ycmd_sent_version;
+		/* The version of the contents that ycmd last got in file_data. */
+#endif
 #ifdef ENABLE_COLOR
 	syntaxtype *syntax;
 		/* The syntax that applies to this file, if any. */
@@ -644,9 +839,3 @@ typedef struct funcstruct {
 		/* Next item in the list. */
 } funcstruct;
 
-#ifdef ENABLE_WORDCOMPLETION
-typedef struct completion_word {
-	char *word;
-	struct completion_word *next;
-} completion_word;
-#endif
@@ -76,7 +76,39 @@ void make_new_buffer(void)
 	openfile->firstcolumn = 0;
 
 	openfile->totsize = 0;
+	openfile->totlines = 1;
+	openfile->lineindex = NULL;
+	openfile->indexed = 0;
+	openfile->indexsize = 0;
+	openfile->unnumbered = 0;
+#ifndef NANO_TINY
+	openfile->rowsbefore = NULL;
+	openfile->rowsindexed = 0;
+	openfile->extrasum = 0;
+	openfile->chunkscounted = FALSE;
+#endif
+	openfile->charsbefore = NULL;
+	openfile->charsindexed = 0;
+#ifndef NANO_TINY
+	openfile->wordsbefore = NULL;
+	openfile->wordsindexed = 0;
+	openfile->depthpair = NULL;
+	openfile->depthbefore = NULL;
+	openfile->lowestdepth = NULL;
+	openfile->depthroom = 0;
+	openfile->depthlevels = 0;
+	openfile->depthsindexed = 0;
+#endif
+
 	openfile->modified = FALSE;
+	openfile->version = 0;
+#ifdef ENABLE_WORDCOMPLETION
+	openfile->words = NULL;
+#endif
+#ifdef ENABLE_YCMD
+	openfile->ycmd_parsed_version = (size_t)-1;
+	openfile->ycmd_sent_version = 0;
+#endif
 #ifdef ENABLE_WRAPPING
 	openfile->spillage_line = NULL;
 #endif
@@ -90,6 +122,7 @@ void make_new_buffer(void)
 	openfile->current_undo = NULL;
 	openfile->last_saved = NULL;
 	openfile->last_action = OTHER;
+	openfile->undoweight = 0;
 
 	openfile->statinfo = NULL;
 	openfile->lock_filename = NULL;
@@ -477,10 +510,12 @@ bool open_buffer(const char *filename, bool new_one)
 	return TRUE;
 }
 
-/* Mark the current file as modified if it isn't already, and
- * then update the title bar to display the file's new status. */
+/* Bump the version of the current buffer, mark it as modified if it
+ * isn't already, and then update the title bar to show the new status. */
 void set_modified(void)
 {
+	openfile->version++;
+
 	if (openfile->modified)
 		return;
 
@@ -500,9 +535,18 @@ void prepare_for_display(void)
 	if (!inhelp)
 		titlebar(NULL);
 
+#ifndef NANO_TINY
+	/* When softwrapping, count the chunks of all lines once, so that
+	 * the scroll bar gets proper totals from the start. */
+	if (ISSET(SOFTWRAP) && !openfile->chunkscounted) {
+		compute_the_extra_rows_per_line_from(openfile->filetop);
+		openfile->chunkscounted = TRUE;
+	}
+#endif
+
 #ifdef ENABLE_COLOR
 	/* Precalculate the data for any multiline coloring regexes. */
-	if (!openfile->filetop->multidata)
+	if (openfile->filetop->multidata == 0)
 		precalc_multicolorinfo();
 	have_palette = FALSE;
 #endif
@@ -513,7 +557,7 @@ void prepare_for_display(void)
 /* Show name of current buffer and its number of lines on the status bar. */
 void mention_name_and_linecount(void)
 {
-	size_t count = openfile->filebot->lineno -
+	size_t count = lineno_of(openfile->filebot) -
 						(openfile->filebot->data[0] == '\0' ? 1 : 0);
 
 #ifndef NANO_TINY
@@ -546,14 +590,14 @@ void redecorate_after_switch(void)
 
 #ifndef NANO_TINY
 	/* While in a different buffer, the effective width of the screen may
-	 * have changed, so make sure that the softwrapped chunks per line and
-	 * the starting column for the first row get corresponding values. */
-	compute_the_extra_rows_per_line_from(openfile->filetop);
+	 * have changed, so make sure that the starting column for the first row
+	 * gets a corresponding value.  The softwrapped chunks of the lines get
+	 * recounted as the lines are drawn, after a first full count below. */
 	ensure_firstcolumn_is_aligned();
 #endif
 
 #ifdef ENABLE_YCMD
-	ycmd_event_buffer_visit(openfile->current_x,(long)openfile->current->lineno,openfile->filename, openfile->filetop);
+	ycmd_event_buffer_visit(openfile->current_x,(long)lineno_of(openfile->current),openfile->filename, openfile->filetop);
 #endif
 
 	/* Update title bar and multiline info to match the current buffer. */
@@ -592,7 +636,7 @@ void switch_to_next_buffer(void)
 void close_buffer(void)
 {
 #ifdef ENABLE_YCMD
-	ycmd_event_buffer_unload(openfile->current_x,(long)openfile->current->lineno,openfile->filename, openfile->filetop);
+	ycmd_event_buffer_unload(openfile->current_x,(long)lineno_of(openfile->current),openfile->filename, openfile->filetop);
 #endif
 
 	openfilestruct *orphan = openfile;
@@ -605,11 +649,24 @@ void close_buffer(void)
 
 	free(orphan->filename);
 	free_lines(orphan->filetop);
+	free(orphan->lineindex);
+	free(orphan->charsbefore);
 #ifndef NANO_TINY
+	free(orphan->rowsbefore);
+	free(orphan->wordsbefore);
+	free(orphan->depthpair);
+	free(orphan->depthbefore);
+	for (int level = 0; level < orphan->depthlevels; level++)
+		free(orphan->lowestdepth[level]);
+	free(orphan->lowestdepth);
 	free(orphan->statinfo);
 	free(orphan->lock_filename);
 	/* Free the undo stack. */
 	discard_until(NULL);
+	forget_the_matches(orphan);
+#endif
+#ifdef ENABLE_WORDCOMPLETION
+	forget_the_words(orphan);
 #endif
 	free(orphan->errormessage);
 
@@ -630,37 +687,57 @@ void close_buffer(void)
 char *encode_data(char *text, size_t length)
 {
 	recode_NUL_to_LF(text, length);
-	text[length] = '\0';
 
-	return copy_of(text);
+	return arena_copy(text, length);
 }
 
-/* The number of bytes by which we expand the line buffer while reading. */
+/* The number of bytes that we read from a file in one go. */
+#define BLOCKSIZE  (256 * 1024)
+
+/* The initial size of the buffer for a line that straddles two blocks. */
 #define LUMPSIZE  120
 
+/* Append count bytes from piece to the partial line of length len in buf,
+ * first doubling the size of the buffer as many times as needed. */
+char *append_to_partial_line(char *buf, size_t *bufsize, size_t len,
+								const char *piece, size_t count)
+{
+	if (len + count > *bufsize) {
+		while (len + count > *bufsize)
+			*bufsize *= 2;
+		buf = nrealloc(buf, *bufsize);
+	}
+
+	memcpy(buf + len, piece, count);
+
+	return buf;
+}
+
 /* Read the given open file f into the current buffer.  filename should be
  * set to the name of the file.  undoable means that undo records should be
  * created and that the file does not need to be checked for writability. */
 void read_file(FILE *f, int fd, const char *filename, bool undoable)
 {
-	ssize_t was_lineno = openfile->current->lineno;
+	ssize_t was_lineno = lineno_of(openfile->current);
 		/* The line number where we start the insertion. */
 	size_t was_leftedge = 0;
 		/* The leftedge where we start the insertion. */
 	size_t num_lines = 0;
 		/* The number of lines in the file. */
 	size_t len = 0;
-		/* The length of the current line of the file. */
+		/* The length of the partial line carried over from the previous block. */
 	size_t bufsize = LUMPSIZE;
-		/* The size of the line buffer; increased as needed. */
+		/* The size of the partial-line buffer; doubled as needed. */
 	char *buf = nmalloc(bufsize);
-		/* The buffer in which we assemble each line of the file. */
+		/* The buffer in which we assemble a line that straddles two blocks. */
+	char *block = nmalloc(BLOCKSIZE);
+		/* The buffer into which we read each block of the file. */
+	size_t got;
+		/* The number of bytes that were read into the block. */
 	linestruct *topline;
 		/* The top of the new buffer where we store the read file. */
 	linestruct *bottomline;
 		/* The bottom of the new buffer. */
-	int onevalue;
-		/* The current value we read from the file, either a byte or EOF. */
 	int errornumber;
 		/* The error code, in case an error occurred during reading. */
 	bool writable = TRUE;
@@ -685,69 +762,104 @@ void read_file(FILE *f, int fd, const char *filename, bool undoable)
 #endif
 
 	/* Lock the file before starting to read it, to avoid the overhead
-	 * of locking it for each single byte that we read from it. */
+	 * of locking it for each block that we read from it. */
 	flockfile(f);
 
 	control_C_was_pressed = FALSE;
 
-	/* Read in the entire file, byte by byte, line by line. */
-	while ((onevalue = getc_unlocked(f)) != EOF) {
-		char input = (char)onevalue;
+	/* Read in the entire file, block by block, cutting each block into lines
+	 * with memchr(), so that each line is copied just once into its node. */
+	while (!control_C_was_pressed && (got = fread(block, 1, BLOCKSIZE, f)) > 0) {
+		char *start = block;
+		char *end = block + got;
+		char *newline = NULL;
+
+		while (start < end) {
+			char *stop, *text;
+			size_t count;
+
+			/* Find the next LF, unless the previous one is still ahead. */
+			if (newline == NULL || newline < start) {
+				newline = memchr(start, '\n', end - start);
+				if (newline == NULL)
+					newline = end;
+			}
 
-		if (control_C_was_pressed)
-			break;
+			stop = (newline < end) ? newline : NULL;
 
-		/* When the byte before the current one is a CR and automatic format
-		 * conversion has not been switched off, then strip this CR when it's
-		 * before a LF OR when the file is in Mac format.  Also, when this is
-		 * the first line break, make a note of the format. */
-		if (input == '\n') {
 #ifndef NANO_TINY
-			if (len > 0 && buf[len - 1] == '\r' && !ISSET(NO_CONVERT)) {
-				if (num_lines == 0)
-					format = DOS_FILE;
-				len--;
+			/* As long as the file may turn out to be in Mac format (when this
+			 * is the first line, or when the first line ended in a bare CR),
+			 * a CR that is not followed by a LF also ends a line. */
+			if ((num_lines == 0 || format == MAC_FILE) && !ISSET(NO_CONVERT)) {
+				char *carriage;
+
+				/* A bare CR at the end of the previous block. */
+				if (len > 0 && buf[len - 1] == '\r' && *start != '\n') {
+					format = MAC_FILE;
+					bottomline->data = encode_data(buf, len - 1);
+					bottomline->next = make_new_node(bottomline);
+					bottomline = bottomline->next;
+					num_lines++;
+					len = 0;
+					continue;
+				}
+
+				carriage = memchr(start, '\r', (stop ? stop : end) - start);
+
+				/* When the CR is the last byte of the block, the next block
+				 * decides, so carry the piece over.  When it's not part of a
+				 * CR+LF pair, the CR is the end of the line. */
+				if (carriage != NULL && carriage + 1 == end)
+					stop = NULL;
+				else if (carriage != NULL && carriage[1] != '\n') {
+					format = MAC_FILE;
+					stop = carriage;
+				}
 			}
-		} else if ((num_lines == 0 || format == MAC_FILE) &&
-					len > 0 && buf[len - 1] == '\r' && !ISSET(NO_CONVERT)) {
-			format = MAC_FILE;
-			len--;
 #endif
-		} else {
-			/* Store the byte. */
-			buf[len] = input;
-
-			/* Keep track of the total length of the line.  It might have
-			 * NUL bytes in it, so we can't just use strlen() later. */
-			len++;
-
-			/* When needed, increase the line-buffer size.  Don't bother
-			 * decreasing it -- it gets freed when reading is finished. */
-			if (len == bufsize) {
-				bufsize += LUMPSIZE;
-				buf = nrealloc(buf, bufsize);
+			/* When there is no line end in the rest of the block,
+			 * keep the piece for completing it with the next block. */
+			if (stop == NULL) {
+				buf = append_to_partial_line(buf, &bufsize, len, start, end - start);
+				len += end - start;
+				break;
 			}
 
-			continue;
-		}
-
-		/* Store the data and make a new line. */
-		bottomline->data = encode_data(buf, len);
-		bottomline->next = make_new_node(bottomline);
-		bottomline = bottomline->next;
-		num_lines++;
+			count = stop - start;
 
-		/* Reset the length in preparation for the next line. */
-		len = 0;
+			/* If the line began in an earlier block, complete it. */
+			if (len > 0) {
+				buf = append_to_partial_line(buf, &bufsize, len, start, count);
+				text = buf;
+				count += len;
+				len = 0;
+			} else
+				text = start;
 
 #ifndef NANO_TINY
-		/* If it was a Mac line, then store the byte after the \r
-		 * as the first byte of the next line. */
-		if (input != '\n')
-			buf[len++] = input;
+			/* When automatic format conversion has not been switched off,
+			 * strip a CR before a LF.  Also, when this is the first line
+			 * break, make a note of the format. */
+			if (*stop == '\n' && count > 0 && text[count - 1] == '\r' &&
+												!ISSET(NO_CONVERT)) {
+				if (num_lines == 0)
+					format = DOS_FILE;
+				count--;
+			}
 #endif
+			/* Store the data and make a new line. */
+			bottomline->data = encode_data(text, count);
+			bottomline->next = make_new_node(bottomline);
+			bottomline = bottomline->next;
+			num_lines++;
+
+			start = stop + 1;
+		}
 	}
 
+	free(block);
+
 	errornumber = errno;
 
 	/* We are done with the file, unlock it. */
@@ -835,9 +947,11 @@ void read_file(FILE *f, int fd, const char *filename, bool undoable)
 	/* If we inserted less than a screenful, don't center the cursor. */
 	if (undoable && less_than_a_screenful(was_lineno, was_leftedge))
 		focusing = FALSE;
+
 #ifdef ENABLE_COLOR
-	else if (undoable)
-		precalc_multicolorinfo();
+	/* Bring the multiline info of the inserted lines and below up to date. */
+	if (undoable)
+		update_the_multis_from(line_from_number(was_lineno));
 #endif
 
 #ifndef NANO_TINY
@@ -1187,7 +1301,7 @@ void do_insertfile(bool execute)
 			statusbar(_("Cancelled"));
 			break;
 		} else {
-			ssize_t was_current_lineno = openfile->current->lineno;
+			ssize_t was_current_lineno = lineno_of(openfile->current);
 			size_t was_current_x = openfile->current_x;
 #if !defined(NANO_TINY) || defined(ENABLE_BROWSER) || defined(ENABLE_MULTIBUFFER)
 			functionptrtype func = func_from_key(&response);
@@ -1286,6 +1400,10 @@ void do_insertfile(bool execute)
 					if (has_old_position(answer, &priorline, &priorcol))
 						do_gotolinecolumn(priorline, priorcol, FALSE, FALSE);
 				}
+#endif
+#ifdef ENABLE_BROWSER
+				/* When a matching line of a search in files was picked, go there. */
+				go_to_chosen_hit();
 #endif
 				/* Update title bar and color info for this new buffer. */
 				prepare_for_display();
@@ -1293,7 +1411,7 @@ void do_insertfile(bool execute)
 #endif /* ENABLE_MULTIBUFFER */
 			{
 				/* If the file actually changed, mark it as modified. */
-				if (openfile->current->lineno != was_current_lineno ||
+				if (lineno_of(openfile->current) != was_current_lineno ||
 									openfile->current_x != was_current_x)
 					set_modified();
 
@@ -1991,10 +2109,8 @@ bool write_file(const char *name, FILE *thefile, bool tmp,
 
 			/* If the syntax changed, discard and recompute the multidata. */
 			if (strcmp(oldname, newname) != 0) {
-				for (line = openfile->filetop; line != NULL; line = line->next) {
-					free(line->multidata);
-					line->multidata = NULL;
-				}
+				for (line = openfile->filetop; line != NULL; line = line->next)
+					discard_multidata(line);
 
 				precalc_multicolorinfo();
 				have_palette = FALSE;
@@ -2051,6 +2167,9 @@ bool write_marked_file(const char *name, FILE *stream, bool tmp,
 	} else
 		stopper = NULL;
 
+	/* The text of the bottom line gets cut short, so it must not be shared. */
+	make_text_private(botline);
+
 	/* Make the marked area look like a separate buffer. */
 	afterline = botline->next;
 	botline->next = stopper;
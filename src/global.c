@@ -78,7 +78,7 @@ message_type lastmessage = VACUUM;
 		/* Messages of type HUSH should not overwrite type MILD nor ALERT. */
 
 linestruct *pletion_line = NULL;
-		/* The line where the last completion was found, if any. */
+		/* The line where the ongoing completion attempt began, if any. */
 
 bool also_the_last = FALSE;
 		/* Whether indenting/commenting should include the last line of
@@ -142,6 +142,8 @@ int *bardata = NULL;
 		/* An array of characters that together depict the scrollbar. */
 ssize_t stripe_column = 0;
 		/* The column at which a vertical bar will be drawn. */
+ssize_t undo_budget = 64;
+		/* How many megabytes of undo data a buffer may keep in memory. */
 #endif
 
 linestruct *cutbuffer = NULL;
@@ -238,7 +240,7 @@ linestruct *executetop = NULL;
 linestruct *executebot = NULL;
 #endif
 
-regex_t search_regexp;
+regex_t *search_regexp = NULL;
 		/* The compiled regular expression to use in searches. */
 regmatch_t regmatches[10];
 		/* The match positions for parenthetical subexpressions, 10
@@ -313,6 +315,9 @@ void to_last_file(void)
 void goto_dir(void)
 {
 }
+void find_in_files(void)
+{
+}
 #endif
 #ifndef NANO_TINY
 void do_nothing(void)
@@ -719,6 +724,8 @@ void shortcut_init(void)
 	const char *browserwherewas_gist = N_("Search backward for a string");
 	const char *browserrefresh_gist = N_("Refresh the file list");
 	const char *gotodir_gist = N_("Go to directory");
+	const char *findinfiles_gist =
+		N_("Search for a string in the files below this directory");
 #endif
 #ifdef ENABLE_COLOR
 	const char *lint_gist = N_("Invoke the linter, if available");
@@ -897,6 +904,9 @@ void shortcut_init(void)
 		N_("Previous"), WITHORSANS(findprev_gist), TOGETHER, VIEW);
 	add_to_funcs(do_findnext, MBROWSER,
 		N_("Next"), WITHORSANS(findnext_gist), BLANKAFTER, VIEW);
+
+	add_to_funcs(find_in_files, MBROWSER,
+		N_("In Files"), WITHORSANS(findinfiles_gist), BLANKAFTER, VIEW);
 #endif
 
 #ifdef NANO_TINY
@@ -1677,6 +1687,7 @@ void shortcut_init(void)
 	add_to_sclist(MBROWSER, "^End", CONTROL_END, to_last_file, 0);
 	add_to_sclist(MBROWSER, "^_", 0, goto_dir, 0);
 	add_to_sclist(MBROWSER, "M-G", 0, goto_dir, 0);
+	add_to_sclist(MBROWSER, "M-F", 0, find_in_files, 0);
 #endif
 	if (ISSET(SAVE_ON_EXIT) && !ISSET(PRESERVE))
 		add_to_sclist(MWRITEFILE, "^Q", 0, discard_buffer, 0);
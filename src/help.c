@@ -358,6 +358,7 @@ void wrap_help_text_into_buffer(void)
 	}
 
 	openfile->filebot = openfile->current;
+	openfile->totlines = openfile->current->lineno;
 	openfile->current = openfile->filetop;
 
 	remove_magicline();
@@ -479,7 +480,7 @@ void show_help(void)
 		} else if (func == do_up || func == do_scroll_up) {
 			do_scroll_up();
 		} else if (func == do_down || func == do_scroll_down) {
-			if (openfile->edittop->lineno + editwinrows - 1 < openfile->filebot->lineno)
+			if (lineno_of(openfile->edittop) + editwinrows - 1 < lineno_of(openfile->filebot))
 				do_scroll_down();
 		} else if (func == do_page_up || func == do_page_down ||
 					func == to_first_line || func == to_last_line) {
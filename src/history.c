@@ -119,7 +119,9 @@ void update_history(linestruct **item, const char *text)
 			*htop = after;
 
 		unlink_node(thesame);
-		renumber_from(after);
+
+		for (linestruct *item = after; item != NULL; item = item->next)
+			item->lineno--;
 	}
 
 	/* If the history is full, delete the oldest item (the one at the
@@ -129,7 +131,9 @@ void update_history(linestruct **item, const char *text)
 
 		*htop = (*htop)->next;
 		unlink_node(oldest);
-		renumber_from(*htop);
+
+		for (linestruct *item = *htop; item != NULL; item = item->next)
+			item->lineno--;
 	}
 
 	/* Store the fresh string in the last item, then create a new item. */
@@ -538,7 +542,7 @@ void update_poshistory(void)
 	}
 
 	/* Don't record files that have the default cursor position. */
-	if (openfile->current->lineno == 1 && openfile->current_x == 0) {
+	if (lineno_of(openfile->current) == 1 && openfile->current_x == 0) {
 		if (posptr != NULL) {
 			if (posprev == NULL)
 				position_history = posptr->next;
@@ -574,7 +578,7 @@ void update_poshistory(void)
 	}
 
 	/* Store the last cursor position. */
-	theone->linenumber = openfile->current->lineno;
+	theone->linenumber = lineno_of(openfile->current);
 	theone->columnnumber = xplustabs() + 1;
 	theone->next = NULL;
 
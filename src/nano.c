@@ -69,18 +69,22 @@ static struct sigaction oldaction, newaction;
 /* Create a new linestruct node.  Note that we do not set prevnode->next. */
 linestruct *make_new_node(linestruct *prevnode)
 {
-	linestruct *newnode = nmalloc(sizeof(linestruct));
+	linestruct *newnode = allocate_node();
 
 	newnode->prev = prevnode;
 	newnode->next = NULL;
 	newnode->data = NULL;
 #ifdef ENABLE_COLOR
-	newnode->multidata = NULL;
+	newnode->multidata = 0;
 #endif
 	newnode->lineno = (prevnode) ? prevnode->lineno + 1 : 1;
+	newnode->charcount = -1;
 #ifndef NANO_TINY
+	newnode->wordcount = -1;
+	newnode->lowestdepth = 1;
 	newnode->extrarows = -2;  /* Bad value, to make it easier to find bugs. */
 	newnode->has_anchor = FALSE;
+	newnode->countedcols = 0;
 #endif
 
 	return newnode;
@@ -108,11 +112,14 @@ void delete_node(linestruct *line)
 	if (line == openfile->spillage_line)
 		openfile->spillage_line = NULL;
 #endif
-	free(line->data);
+	free_data(line->data);
 #ifdef ENABLE_COLOR
-	free(line->multidata);
+	discard_multidata(line);
 #endif
-	free(line);
+#ifndef NANO_TINY
+	forget_the_checkpoints_of(line);
+#endif
+	release_node(line);
 }
 
 /* Disconnect a node from a linked list of linestructs and delete it. */
@@ -147,16 +154,20 @@ void free_lines(linestruct *src)
 /* Make a copy of a linestruct node. */
 linestruct *copy_node(const linestruct *src)
 {
-	linestruct *dst = nmalloc(sizeof(linestruct));
+	linestruct *dst = allocate_node();
 
-	dst->data = copy_of(src->data);
+	dst->data = share_data(src->data);
 #ifdef ENABLE_COLOR
-	dst->multidata = NULL;
+	dst->multidata = 0;
 #endif
 	dst->lineno = src->lineno;
+	dst->charcount = src->charcount;
 #ifndef NANO_TINY
-	dst->extrarows = src->extrarows;
+	dst->wordcount = src->wordcount;
+	dst->lowestdepth = 1;
+	dst->extrarows = -2;  /* The copy is not counted in any buffer. */
 	dst->has_anchor = FALSE;
+	dst->countedcols = 0;
 #endif
 
 	return dst;
@@ -186,15 +197,19 @@ linestruct *copy_buffer(const linestruct *src)
 	return head;
 }
 
-/* Renumber the lines in a buffer, from the given line onwards. */
+/* Note that the lines of the current buffer need renumbering from the given
+ * line onward.  The renumbering itself is done lazily, by lineno_of() and
+ * line_from_number(), and only as far as the numbers are asked for. */
 void renumber_from(linestruct *line)
 {
-	ssize_t number = (line->prev == NULL) ? 0 : line->prev->lineno;
+	ssize_t number = (line->prev == NULL) ? 1 : line->prev->lineno + 1;
 
-	while (line != NULL) {
-		line->lineno = ++number;
-		line = line->next;
-	}
+	/* A preceding line with a stale number lies beyond the point that was
+	 * noted before, so at worst this makes the noted point lower than needed. */
+	if (openfile->unnumbered == 0 || number < openfile->unnumbered)
+		openfile->unnumbered = number;
+
+	forget_index_from(openfile->unnumbered);
 }
 
 /* Display a warning about a key disabled in view mode. */
@@ -1132,12 +1147,43 @@ void handle_sigwinch(int signal)
 	the_window_resized = TRUE;
 }
 
+/* Compute and store how many extra rows the given line needs when softwrapping,
+ * and adjust the tally of extra rows of the current buffer accordingly.
+ * (A line with a negative amount has not been counted in the tally.) */
+void compute_the_extra_rows_of(linestruct *line)
+{
+	ssize_t amount = extra_chunks_in(line);
+	ssize_t counted = (line->extrarows < 0) ? 0 : line->extrarows;
+
+	if (amount != counted) {
+		openfile->extrasum += amount - counted;
+		forget_rows_from(line->lineno);
+	}
+
+	line->extrarows = amount;
+	line->countedcols = editwincols;
+}
+
+/* Take the extra rows of the lines from top to bot, which are about to leave
+ * the current buffer, out of the tally of extra rows of the buffer. */
+void discount_the_extra_rows(linestruct *top, const linestruct *bot)
+{
+	for (linestruct *line = top; ; line = line->next) {
+		if (line->extrarows > 0)
+			openfile->extrasum -= line->extrarows;
+		line->extrarows = -2;
+
+		if (line == bot)
+			break;
+	}
+}
+
 /* Compute and store how many extra rows each line needs when softwrapping. */
 void compute_the_extra_rows_per_line_from(linestruct *fromline)
 {
 	if (ISSET(SOFTWRAP))
 		for (linestruct *line = fromline; line != NULL; line = line->next)
-			line->extrarows = extra_chunks_in(line);
+			compute_the_extra_rows_of(line);
 }
 
 /* Reinitialize and redraw the screen completely. */
@@ -1182,7 +1228,6 @@ void regenerate_screen(void)
 
 	/* If we have an open buffer, redraw the contents of the subwindows. */
 	if (openfile) {
-		compute_the_extra_rows_per_line_from(openfile->filetop);
 		ensure_firstcolumn_is_aligned();
 		draw_all_subwindows();
 	}
@@ -1208,10 +1253,24 @@ void do_toggle(int flag)
 			break;
 #endif
 		case SOFTWRAP:
-			if (ISSET(SOFTWRAP))
+			if (ISSET(SOFTWRAP)) {
 				compute_the_extra_rows_per_line_from(openfile->filetop);
-			else
+				openfile->chunkscounted = TRUE;
+			} else {
+				/* Without softwrapping, the chunks are not kept up to date,
+				 * so each buffer needs a full count when shown again. */
+#ifdef ENABLE_MULTIBUFFER
+				openfilestruct *buffer = openfile;
+
+				do {
+					buffer->chunkscounted = FALSE;
+					buffer = buffer->next;
+				} while (buffer != openfile);
+#else
+				openfile->chunkscounted = FALSE;
+#endif
 				openfile->firstcolumn = 0;
+			}
 			refresh_needed = TRUE;
 			break;
 		case WHITESPACE_DISPLAY:
@@ -1359,7 +1418,7 @@ int get_keycode(const char *keyname, const int standard)
 /* Ensure that the margin can accommodate the buffer's highest line number. */
 void confirm_margin(void)
 {
-	int needed_margin = digits(openfile->filebot->lineno) + 1;
+	int needed_margin = digits(lineno_of(openfile->filebot)) + 1;
 
 	/* When not requested or space is too tight, suppress line numbers. */
 	if (!ISSET(LINE_NUMBERS) || needed_margin > COLS - 4)
@@ -1372,9 +1431,8 @@ void confirm_margin(void)
 		editwincols = COLS - margin - thebar;
 
 #ifndef NANO_TINY
-		/* Recompute the softwrapped chunks for each line in the buffer,
-		 * and ensure a proper starting column for the first screen row. */
-		compute_the_extra_rows_per_line_from(openfile->filetop);
+		/* Ensure a proper starting column for the first screen row.
+		 * The softwrapped chunks get recounted as lines are drawn. */
 		ensure_firstcolumn_is_aligned();
 		focusing = keep_focus;
 #endif
@@ -1558,7 +1616,7 @@ void inject(char *burst, size_t count)
 	/* Only add a new undo item when the current item is not an ADD or when
 	 * the current typing is not contiguous with the previous typing. */
 	if (openfile->last_action != ADD ||
-				openfile->current_undo->tail_lineno != thisline->lineno ||
+				openfile->current_undo->tail_lineno != lineno_of(thisline) ||
 				openfile->current_undo->tail_x != openfile->current_x)
 		add_undo(ADD, NULL);
 #endif
@@ -1569,6 +1627,7 @@ void inject(char *burst, size_t count)
 						thisline->data + openfile->current_x,
 						datalen - openfile->current_x + 1);
 	strncpy(thisline->data + openfile->current_x, burst, count);
+	forget_the_counts_of(thisline);
 
 #ifndef NANO_TINY
 	/* When the mark is to the right of the cursor, compensate its position. */
@@ -1610,7 +1669,7 @@ void inject(char *burst, size_t count)
 	 * or we were on the last row of the edit window and moved to a new chunk,
 	 * we need a full refresh. */
 	if (ISSET(SOFTWRAP)) {
-		openfile->current->extrarows = extra_chunks_in(openfile->current);
+		compute_the_extra_rows_of(openfile->current);
 		if (openfile->current->extrarows != old_amount ||
 					(openfile->current_y == editwinrows - 1 &&
 					chunk_for(xplustabs(), openfile->current) > original_row)) {
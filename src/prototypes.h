@@ -97,6 +97,7 @@ extern int thebar;
 #ifndef NANO_TINY
 extern int *bardata;
 extern ssize_t stripe_column;
+extern ssize_t undo_budget;
 #endif
 
 extern linestruct *cutbuffer;
@@ -163,7 +164,7 @@ extern linestruct *executetop;
 extern linestruct *executebot;
 #endif
 
-extern regex_t search_regexp;
+extern regex_t *search_regexp;
 extern regmatch_t regmatches[10];
 
 extern int hilite_attribute;
@@ -187,9 +188,12 @@ extern size_t light_to_col;
 
 typedef void (*functionptrtype)(void);
 
-/* The two needed functions from browser.c. */
+/* The needed functions from browser.c. */
 #ifdef ENABLE_BROWSER
 void browser_refresh(void);
+bool searching_files(void);
+int search_files_until_keystroke(WINDOW *frame);
+void go_to_chosen_hit(void);
 char *browse_in(const char *inpath);
 #endif
 
@@ -236,7 +240,18 @@ bool white_string(const char *string);
 void set_interface_colorpairs(void);
 void prepare_palette(void);
 void find_and_prime_applicable_syntax(void);
+short multistate_of(const linestruct *line, short id);
+void set_multistate(linestruct *line, short id, short state);
+void discard_multidata(linestruct *line);
 void check_the_multis(linestruct *line);
+bool update_the_multis_from(linestruct *line);
+bool could_match(const char *text, const char *needle, bool caseless);
+#if USE_OPENMP
+char scan_for_starts(const char *text, int index, const colortype *ink,
+						const regex_t *start, const regex_t *end);
+void precalc_multicolorinfo_in_parallel(void);
+#endif
+const paintstruct *paint_of(const linestruct *line, size_t reach);
 void precalc_multicolorinfo(void);
 #endif
 
@@ -409,6 +424,8 @@ void block_sigwinch(bool blockit);
 #endif
 #ifndef NANO_TINY
 void handle_sigwinch(int signal);
+void compute_the_extra_rows_of(linestruct *line);
+void discount_the_extra_rows(linestruct *top, const linestruct *bot);
 void compute_the_extra_rows_per_line_from(linestruct *fromline);
 void regenerate_screen(void);
 void do_toggle(int flag);
@@ -451,6 +468,11 @@ void do_rcfiles(void);
 /* Most functions in search.c. */
 bool regexp_init(const char *regexp);
 void tidy_up_after_search(void);
+#ifndef NANO_TINY
+bool counting_is_pending(void);
+void forget_the_matches(const openfilestruct *buffer);
+int count_matches_until_keystroke(WINDOW *frame);
+#endif
 int findnextstr(const char *needle, bool whole_word_only, int modus,
 		size_t *match_len, bool skipone, const linestruct *begin, size_t begin_x);
 void do_search_forward(void);
@@ -491,8 +513,15 @@ void do_redo(void);
 void do_enter(void);
 #ifndef NANO_TINY
 void discard_until(const undostruct *thisitem);
+size_t weight_of(const undostruct *u);
+void spill_string(const char *text);
+char *unspill_string(void);
+bool spill_undo_item(undostruct *u);
+void fetch_undo_item(undostruct *u);
+void keep_undo_within_budget(void);
 void add_undo(undo_type action, const char *message);
 void update_multiline_undo(ssize_t lineno, char *indentation);
+void make_room_for(undostruct *u, size_t extra, bool in_front);
 void update_undo(undo_type action);
 #endif /* !NANO_TINY */
 #ifdef ENABLE_WRAPPING
@@ -523,6 +552,9 @@ void do_formatter(void);
 void do_wordlinechar_count(void);
 #endif
 void do_verbatim_input(void);
+#ifdef ENABLE_WORDCOMPLETION
+void forget_the_words(openfilestruct *buffer);
+#endif
 void complete_a_word(void);
 
 /* All functions in utils.c. */
@@ -543,11 +575,25 @@ bool is_separate_word(size_t position, size_t length, const char *buf);
 const char *strstrwrapper(const char *haystack, const char *needle,
 		const char *start);
 void *nmalloc(size_t howmuch);
+linestruct *allocate_node(void);
+void release_node(linestruct *node);
+arenachunk *chunk_holding(const void *text);
+void let_go_of(arenachunk *chunk);
+void discard_chunk(arenachunk *chunk);
+arenachunk *add_chunk(size_t size);
+char *arena_copy(const char *text, size_t count);
+char *share_data(char *text);
+void make_text_private(linestruct *line);
+void free_data(char *text);
 void *nrealloc(void *ptr, size_t howmuch);
 char *measured_copy(const char *string, size_t count);
 char *mallocstrcpy(char *dest, const char *src);
 char *copy_of(const char *string);
 char *free_and_assign(char *dest, char *src);
+#ifndef NANO_TINY
+void forget_the_checkpoints_of(const linestruct *line);
+void plant_checkpoints_in(linestruct *line);
+#endif
 size_t get_page_start(size_t column);
 size_t xplustabs(void);
 size_t actual_x(const char *text, size_t column);
@@ -557,15 +603,27 @@ void new_magicline(void);
 #if !defined(NANO_TINY) || defined(ENABLE_HELP)
 void remove_magicline(void);
 #endif
+void forget_index_from(ssize_t number);
+void settle_numbers(const linestruct *target, ssize_t upto);
+ssize_t lineno_of(const linestruct *line);
+linestruct *line_from_number(ssize_t number);
+void forget_the_counts_of(linestruct *line);
+size_t chars_in(linestruct *line);
 #ifndef NANO_TINY
+size_t words_between(const char *text, size_t start, size_t end);
+size_t words_in(linestruct *line);
+#endif
+size_t total_before(const linestruct *line, bool words);
+#ifndef NANO_TINY
+void aim_the_depths_at(const char *pair);
+linestruct *line_that_balances(linestruct *line, bool reverse, size_t *balance);
+void forget_rows_from(ssize_t number);
+size_t extra_rows_before(const linestruct *line);
 bool mark_is_before_cursor(void);
 void get_region(linestruct **top, size_t *top_x, linestruct **bot, size_t *bot_x);
 void get_range(linestruct **top, linestruct **bot);
 #endif
-size_t number_of_characters_in(const linestruct *begin, const linestruct *end);
-#ifndef NANO_TINY
-linestruct *line_from_number(ssize_t number);
-#endif
+size_t number_of_characters_in(linestruct *begin, const linestruct *end);
 
 /* Most functions in winio.c. */
 void record_macro(void);
@@ -641,6 +699,7 @@ void to_files(void);
 void to_first_file(void);
 void to_last_file(void);
 void goto_dir(void);
+void find_in_files(void);
 #endif
 #ifndef NANO_TINY
 void do_nothing(void);
@@ -117,6 +117,7 @@ static const rcoption rcopts[] = {
 	{"tabsize", 0},
 	{"tabstospaces", TABS_TO_SPACES},
 	{"trimblanks", TRIM_BLANKS},
+	{"undobudget", 0},
 	{"unix", MAKE_IT_UNIX},
 	{"whitespace", 0},
 	{"wordbounds", WORD_BOUNDS},
@@ -452,6 +453,8 @@ keystruct *strtosc(const char *input)
 		s->func = to_files;
 	else if (!strcmp(input, "gotodir"))
 		s->func = goto_dir;
+	else if (!strcmp(input, "findinfiles"))
+		s->func = find_in_files;
 	else if (!strcmp(input, "firstfile"))
 		s->func = to_first_file;
 	else if (!strcmp(input, "lastfile"))
@@ -643,6 +646,106 @@ bool compile(const char *expression, int rex_flags, regex_t **packed)
 	return (outcome == 0);
 }
 
+#ifdef ENABLE_COLOR
+/* Return the longest stretch of literal characters that every match of the
+ * given extended regular expression must contain, or NULL when no such
+ * stretch can be determined.  For a caseless regex only ASCII is taken. */
+char *literal_in(const char *expression, bool caseless)
+{
+	char *stretch = nmalloc(strlen(expression) + 1);
+	size_t length = 0, longest = 0;
+	const char *ptr = expression;
+	char *result = NULL;
+	int depth = 0;
+
+	while (TRUE) {
+		const char *atom = ptr;
+			/* Where the current element starts, if it is a literal. */
+		bool literal = FALSE;
+			/* Whether the current element is a single literal character. */
+
+		if (*ptr == '\\' && ptr[1] != '\0') {
+			/* An escaped letter or digit is a class, an anchor or a back
+			 * reference, and so are a few escaped punctuation characters. */
+			literal = (depth == 0) && !isalnum((unsigned char)ptr[1]) &&
+											strchr("<>`'", ptr[1]) == NULL;
+			atom = ++ptr;
+			ptr++;
+		} else if (*ptr == '[') {
+			/* Skip over the bracket expression, including any classes. */
+			ptr++;
+			if (*ptr == '^')
+				ptr++;
+			if (*ptr == ']')
+				ptr++;
+			while (*ptr != '\0' && *ptr != ']') {
+				if (*ptr == '[' && (ptr[1] == ':' || ptr[1] == '.' || ptr[1] == '=')) {
+					const char *closer = strchr(ptr + 2, ptr[1]);
+
+					while (closer != NULL && closer[1] != ']')
+						closer = strchr(closer + 1, ptr[1]);
+					ptr = (closer == NULL) ? ptr + 1 : closer + 2;
+				} else
+					ptr++;
+			}
+			if (*ptr == ']')
+				ptr++;
+		} else if (*ptr == '|' && depth == 0) {
+			/* An alternation at the top level requires no single literal. */
+			longest = 0;
+			free(result);
+			result = NULL;
+			break;
+		} else if (*ptr == '(') {
+			depth++;
+			ptr++;
+		} else if (*ptr == ')') {
+			if (depth > 0)
+				depth--;
+			ptr++;
+		} else if (*ptr != '\0' && strchr(".^$*+?{|\\", *ptr) != NULL)
+			ptr++;
+		else if (*ptr != '\0') {
+			literal = (depth == 0) && !(caseless && (signed char)*ptr < 0);
+			ptr += char_length(ptr);
+		}
+
+		/* Unless a quantifier makes the element optional, a literal character
+		 * extends the stretch.  Anything else ends it, as does a repetition. */
+		if (literal && *ptr != '*' && *ptr != '?' && *ptr != '{') {
+			strncpy(stretch + length, atom, ptr - atom);
+			length += ptr - atom;
+			literal = (*ptr != '+');
+		} else
+			literal = FALSE;
+
+		if (!literal || *ptr == '\0') {
+			if (length > longest) {
+				longest = length;
+				result = free_and_assign(result, measured_copy(stretch, length));
+			}
+			length = 0;
+		}
+
+		if (*ptr == '\0')
+			break;
+
+		/* Skip over a quantifier. */
+		if (*ptr == '{') {
+			while (*ptr != '\0' && *ptr != '}')
+				ptr++;
+			if (*ptr == '}')
+				ptr++;
+		} else if (*ptr == '*' || *ptr == '?' || *ptr == '+')
+			ptr++;
+	}
+
+	free(stretch);
+
+	return result;
+}
+#endif /* ENABLE_COLOR */
+
 /* Parse the next syntax name and its possible extension regexes from the
  * line at ptr, and add it to the global linked list of color syntaxes. */
 void begin_new_syntax(char *ptr)
@@ -1121,7 +1224,7 @@ bool parse_combination(char *combostr, short *fg, short *bg, int *attributes)
  * add a rule to the current syntax. */
 void parse_rule(char *ptr, int rex_flags)
 {
-	char *names, *regexstring;
+	char *names, *startstring, *endstring;
 	short fg, bg;
 	int attributes;
 
@@ -1154,11 +1257,11 @@ void parse_rule(char *ptr, int rex_flags)
 			expectend = TRUE;
 		}
 
-		regexstring = ++ptr;
+		startstring = ++ptr;
 		ptr = parse_next_regex(ptr);
 
 		/* When there is no regex, or it is invalid, skip this line. */
-		if (ptr == NULL || !compile(regexstring, rex_flags, &start_rgx))
+		if (ptr == NULL || !compile(startstring, rex_flags, &start_rgx))
 			return;
 
 		if (expectend) {
@@ -1169,11 +1272,11 @@ void parse_rule(char *ptr, int rex_flags)
 				return;
 			}
 
-			regexstring = ptr + 5;
+			endstring = ptr + 5;
 			ptr = parse_next_regex(ptr + 5);
 
 			/* When there is no valid end= regex, abandon the rule. */
-			if (ptr == NULL || !compile(regexstring, rex_flags, &end_rgx)) {
+			if (ptr == NULL || !compile(endstring, rex_flags, &end_rgx)) {
 				regfree(start_rgx);
 				free(start_rgx);
 				return;
@@ -1186,6 +1289,15 @@ void parse_rule(char *ptr, int rex_flags)
 		newcolor->start = start_rgx;
 		newcolor->end = end_rgx;
 
+		/* Note the literals that the regexes need, for skipping lines quickly. */
+		newcolor->caseless = (rex_flags & REG_ICASE);
+		newcolor->needle = literal_in(startstring, newcolor->caseless);
+		newcolor->endneedle = (expectend) ? literal_in(endstring, newcolor->caseless) : NULL;
+#if USE_OPENMP
+		newcolor->expression = (expectend) ? copy_of(startstring) : NULL;
+		newcolor->endexpression = (expectend) ? copy_of(endstring) : NULL;
+#endif
+
 		newcolor->fg = fg;
 		newcolor->bg = bg;
 		newcolor->attributes = attributes;
@@ -1645,6 +1757,13 @@ void parse_rcfile(FILE *rcstream, bool just_syntax, bool intros_only)
 				jot_error(N_("Requested tab size \"%s\" is invalid"), argument);
 				tabsize = -1;
 			}
+		} else if (strcmp(option, "undobudget") == 0) {
+			ssize_t megabytes;
+
+			if (!parse_num(argument, &megabytes) || megabytes < 0)
+				jot_error(N_("Undo budget \"%s\" is invalid"), argument);
+			else
+				undo_budget = megabytes;
 		}
 #else
 		;  /* Properly terminate any earlier 'else'. */
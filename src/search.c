@@ -26,41 +26,116 @@
 
 static bool came_full_circle = FALSE;
 		/* Have we reached the starting line again while searching? */
-static bool have_compiled_regexp = FALSE;
-		/* Whether we have compiled a regular expression for the search. */
+#define REGEX_CACHE_SIZE  8
+		/* How many compiled search expressions are kept for reuse. */
+
+static regexcachestruct regex_cache[REGEX_CACHE_SIZE];
+		/* The recently compiled search expressions. */
+static size_t regex_uses = 0;
+		/* The number of times that a compiled expression was asked for. */
+static size_t regex_hits = 0;
+		/* How many of those times the expression was already compiled. */
+#ifndef NANO_TINY
+#define COUNTING_SLICE  2000
+		/* How many lines to count matches in between looks at the keyboard. */
+#define MAX_TABULATED  (1 << 20)
+		/* Beyond this number of matches, their positions are not remembered. */
+
+static openfilestruct *counted_buffer = NULL;
+		/* The buffer in which the matches of a search string are counted. */
+static size_t counted_version = 0;
+		/* The version of that buffer for which the count is valid. */
+static char *counted_needle = NULL;
+		/* The search string whose matches are counted. */
+static bool counted_as_regex, counted_with_case;
+		/* The search modes with which the matches are counted. */
+static regex_t counting_regexp;
+		/* A private compilation of the search string, when a regex. */
+static linestruct *counting_line = NULL;
+		/* The next line to count matches in, or NULL when done. */
+static size_t match_count = 0;
+		/* The number of matches counted so far. */
+static matchstruct *matches = NULL;
+		/* The positions of the counted matches, in buffer order. */
+static size_t matches_room = 0;
+		/* The number of positions for which there is room. */
+static time_t last_report = 0;
+		/* When the progress of the counting was last shown. */
+static bool count_is_shown = FALSE;
+		/* Whether the status bar shows a message about the count. */
+static clock_t batch_duration = 0;
+		/* How much processor time the last replacing in one go took. */
+#endif
 
-/* Compile the given regular expression and store it in search_regexp.
+/* Compile the given regular expression and let search_regexp point to it,
+ * reusing an earlier compilation with the same flags when there is one.
  * Return TRUE if the expression is valid, and FALSE otherwise. */
 bool regexp_init(const char *regexp)
 {
-	int value = regcomp(&search_regexp, regexp,
-				NANO_REG_EXTENDED | (ISSET(CASE_SENSITIVE) ? 0 : REG_ICASE));
+	int cflags = NANO_REG_EXTENDED | (ISSET(CASE_SENSITIVE) ? 0 : REG_ICASE);
+	regexcachestruct *slot = &regex_cache[0];
+	int value;
+
+	regex_uses++;
+
+	/* Look for the expression among the cached ones, and meanwhile
+	 * determine which slot was used longest ago (or not at all). */
+	for (int index = 0; index < REGEX_CACHE_SIZE; index++) {
+		regexcachestruct *entry = &regex_cache[index];
+
+		if (entry->pattern != NULL && entry->cflags == cflags &&
+								strcmp(entry->pattern, regexp) == 0) {
+			entry->last_use = regex_uses;
+			search_regexp = &entry->compiled;
+			regex_hits++;
+			return TRUE;
+		}
+
+		if (entry->last_use < slot->last_use)
+			slot = entry;
+	}
+
+#ifdef DEBUG
+	fprintf(stderr, "Regex cache: %zu hits, %zu misses\n",
+						regex_hits, regex_uses - regex_hits);
+#endif
+
+	if (slot->pattern != NULL) {
+		regfree(&slot->compiled);
+		free(slot->pattern);
+		slot->pattern = NULL;
+	}
+
+	slot->last_use = 0;
+	search_regexp = NULL;
+
+	value = regcomp(&slot->compiled, regexp, cflags);
 
 	/* If regex compilation failed, show the error message. */
 	if (value != 0) {
-		size_t len = regerror(value, &search_regexp, NULL, 0);
+		size_t len = regerror(value, &slot->compiled, NULL, 0);
 		char *str = nmalloc(len);
 
-		regerror(value, &search_regexp, str, len);
+		regerror(value, &slot->compiled, str, len);
 		statusline(AHEM, _("Bad regex \"%s\": %s"), regexp, str);
 		free(str);
 
 		return FALSE;
 	}
 
-	have_compiled_regexp = TRUE;
+	slot->pattern = copy_of(regexp);
+	slot->cflags = cflags;
+	slot->last_use = regex_uses;
+
+	search_regexp = &slot->compiled;
 
 	return TRUE;
 }
 
-/* Free a compiled regular expression, if one was compiled; and schedule a
- * full screen refresh when the mark is on, in case the cursor has moved. */
+/* Schedule a full screen refresh when the mark is on, in case the cursor
+ * has moved.  (The compiled expression stays cached, for reuse.) */
 void tidy_up_after_search(void)
 {
-	if (have_compiled_regexp) {
-		regfree(&search_regexp);
-		have_compiled_regexp = FALSE;
-	}
 #ifndef NANO_TINY
 	if (openfile->mark)
 		refresh_needed = TRUE;
@@ -152,7 +227,7 @@ void search_init(bool replacing, bool retain_answer)
 			} else
 				replacing = !replacing;
 		} else if (func == flip_goto) {
-			do_gotolinecolumn(openfile->current->lineno,
+			do_gotolinecolumn(lineno_of(openfile->current),
 								openfile->placewewant + 1, TRUE, TRUE);
 			break;
 		} else
@@ -163,6 +238,213 @@ void search_init(bool replacing, bool retain_answer)
 	free(thedefault);
 }
 
+#ifndef NANO_TINY
+/* Return TRUE when the matches in the current buffer are being counted
+ * (or have been counted) for the given search string and search modes. */
+bool count_is_for(const char *needle)
+{
+	return (counted_buffer == openfile && counted_version == openfile->version &&
+				counted_needle != NULL && strcmp(counted_needle, needle) == 0 &&
+				counted_as_regex == ISSET(USE_REGEXP) &&
+				counted_with_case == ISSET(CASE_SENSITIVE));
+}
+
+/* Return TRUE when the positions of all matches of the given string
+ * in the current buffer are known. */
+bool matches_are_known(const char *needle)
+{
+	return (count_is_for(needle) && counting_line == NULL &&
+				match_count <= MAX_TABULATED);
+}
+
+/* Return TRUE when the matches of the last search have not all been counted
+ * yet, and the current buffer has not changed since the counting began. */
+bool counting_is_pending(void)
+{
+	return (counting_line != NULL && counted_buffer == openfile &&
+				counted_version == openfile->version);
+}
+
+/* Begin counting the matches of the given string in the current buffer. */
+void start_counting_matches(const char *needle)
+{
+	forget_the_matches(counted_buffer);
+
+	counted_as_regex = ISSET(USE_REGEXP);
+	counted_with_case = ISSET(CASE_SENSITIVE);
+
+	if (counted_as_regex && regcomp(&counting_regexp, needle, NANO_REG_EXTENDED |
+								(counted_with_case ? 0 : REG_ICASE)) != 0)
+		return;
+
+	/* The table gets ordered by line number, so make sure these are right. */
+	if (openfile->unnumbered != 0)
+		settle_numbers(NULL, 0);
+
+	counted_needle = mallocstrcpy(counted_needle, needle);
+	counted_buffer = openfile;
+	counted_version = openfile->version;
+	counting_line = openfile->filetop;
+	match_count = 0;
+	last_report = time(NULL);
+	count_is_shown = FALSE;
+}
+
+/* Stop counting (and forget the counted matches) when this is the buffer
+ * in which they were counted. */
+void forget_the_matches(const openfilestruct *buffer)
+{
+	if (counted_buffer != buffer)
+		return;
+
+	if (counted_as_regex && counted_needle != NULL)
+		regfree(&counting_regexp);
+
+	free(counted_needle);
+	counted_needle = NULL;
+	counted_buffer = NULL;
+	counting_line = NULL;
+	match_count = 0;
+}
+
+/* Add a match of the given length at the given position to the table,
+ * or merely count it when the table has become too large. */
+void tabulate_match(linestruct *line, size_t x, size_t length)
+{
+	if (match_count < MAX_TABULATED) {
+		if (match_count == matches_room) {
+			matches_room = 2 * matches_room + 64;
+			matches = nrealloc(matches, matches_room * sizeof(matchstruct));
+		}
+
+		matches[match_count].line = line;
+		matches[match_count].x = x;
+		matches[match_count].length = length;
+	}
+
+	match_count++;
+}
+
+/* Return the index of the first tabulated match that starts beyond the given
+ * position, or at that position itself when inclusive is TRUE. */
+size_t first_match_from(const linestruct *line, size_t x, bool inclusive)
+{
+	size_t lower = 0, upper = match_count;
+
+	while (lower < upper) {
+		size_t middle = (lower + upper) / 2;
+
+		if (lineno_of(matches[middle].line) < lineno_of(line) ||
+						(matches[middle].line == line && (matches[middle].x < x ||
+						(!inclusive && matches[middle].x == x))))
+			lower = middle + 1;
+		else
+			upper = middle;
+	}
+
+	return lower;
+}
+
+/* Return TRUE when the status bar is empty or shows an earlier report. */
+bool may_report(void)
+{
+	return (lastmessage == VACUUM || (count_is_shown && lastmessage == INFO));
+}
+
+/* Report the number of matches, and which of them is at the cursor. */
+void report_the_count(void)
+{
+	size_t index = (match_count > MAX_TABULATED) ? match_count :
+				first_match_from(openfile->current, openfile->current_x, TRUE);
+
+	if (index < match_count && matches[index].line == openfile->current &&
+						matches[index].x == openfile->current_x)
+		statusline(INFO, _("Match %zu of %zu"), index + 1, match_count);
+	else
+		statusline(INFO, P_("%zu match", "%zu matches", match_count), match_count);
+
+	count_is_shown = TRUE;
+}
+
+/* Count the matches in the next slice of lines of the buffer.  When done,
+ * report the total; when taking long, report the progress every second. */
+void count_some_matches(void)
+{
+	size_t lines = 0, bytes = 0;
+
+	while (counting_line != NULL && lines++ < COUNTING_SLICE && bytes < 1000000) {
+		const char *data = counting_line->data;
+
+		if (counted_as_regex) {
+			size_t far_end = strlen(data);
+			size_t reach = 0;
+			regmatch_t match;
+
+			/* Note the start of every match that a search could land on. */
+			while (reach <= far_end) {
+				match.rm_so = reach;
+				match.rm_eo = far_end;
+				if (regexec(&counting_regexp, data, 1, &match, REG_STARTEND) != 0)
+					break;
+				tabulate_match(counting_line, match.rm_so, match.rm_eo - match.rm_so);
+				reach = step_right(data, match.rm_so);
+			}
+		} else {
+			size_t length = strlen(counted_needle);
+			const char *found = data;
+
+			while ((found = (counted_with_case ? strstr(found, counted_needle) :
+										mbstrcasestr(found, counted_needle)))) {
+				tabulate_match(counting_line, found - data, length);
+				found += char_length(found);
+			}
+		}
+
+		bytes += strlen(data);
+		counting_line = counting_line->next;
+	}
+
+	if (!may_report())
+		count_is_shown = FALSE;
+	else if (counting_line == NULL)
+		report_the_count();
+	else if (time(NULL) > last_report) {
+		statusline(INFO, _("Counting matches... %zu so far"), match_count);
+		count_is_shown = TRUE;
+		last_report = time(NULL);
+	}
+}
+
+/* Count the matches of the last search until a keystroke arrives in the
+ * given window, or until they are all counted.  Return the keystroke, or ERR. */
+int count_matches_until_keystroke(WINDOW *frame)
+{
+	int input = ERR;
+
+	nodelay(frame, TRUE);
+
+	while (input == ERR && counting_is_pending()) {
+		count_some_matches();
+
+		if (count_is_shown) {
+			place_the_cursor();
+			doupdate();
+		}
+
+		input = wgetch(frame);
+
+		if (the_window_resized) {
+			regenerate_screen();
+			return KEY_WINCH;
+		}
+	}
+
+	nodelay(frame, FALSE);
+
+	return input;
+}
+#endif /* !NANO_TINY */
+
 /* Look for needle, starting at (current, current_x).  begin is the line
  * where we first started searching, at column begin_x.  Return 1 when we
  * found something, 0 when nothing, and -2 on cancel.  When match_len is
@@ -185,6 +467,37 @@ int findnextstr(const char *needle, bool whole_word_only, int modus,
 	time_t lastkbcheck = time(NULL);
 		/* The time we last looked at the keyboard. */
 
+#ifndef NANO_TINY
+	/* When the positions of all matches are known, jump to the nearest one. */
+	if (modus == JUSTFIND && skipone && !whole_word_only && matches_are_known(needle)) {
+		size_t index;
+
+		if (match_count == 0)
+			return 0;
+
+		if (ISSET(BACKWARDS_SEARCH)) {
+			index = first_match_from(line, openfile->current_x, TRUE);
+			if (index == 0) {
+				index = match_count;
+				statusline(REMARK, _("Search Wrapped"));
+			}
+			index--;
+		} else {
+			index = first_match_from(line, openfile->current_x, FALSE);
+			if (index == match_count) {
+				index = 0;
+				statusline(REMARK, _("Search Wrapped"));
+			}
+		}
+
+		line = matches[index].line;
+		found_x = matches[index].x;
+		found_len = matches[index].length;
+
+		goto land_there;
+	}
+#endif
+
 	/* Set non-blocking input so that we can just peek for a Cancel. */
 	nodelay(edit, TRUE);
 
@@ -314,6 +627,9 @@ int findnextstr(const char *needle, bool whole_word_only, int modus,
 						(ISSET(BACKWARDS_SEARCH) && found_x < begin_x)))
 		return 0;
 
+#ifndef NANO_TINY
+  land_there:
+#endif
 	/* Set the current position to point at what we found. */
 	openfile->current = line;
 	openfile->current_x = found_x;
@@ -438,6 +754,15 @@ void go_looking(void)
 	else if (didfind == 0)
 		not_found_msg(last_search);
 
+#ifndef NANO_TINY
+	/* Tell which match this is, or else start counting the matches. */
+	if (didfind == 1 && matches_are_known(last_search)) {
+		if (may_report())
+			report_the_count();
+	} else if (didfind == 1 && !count_is_for(last_search))
+		start_counting_matches(last_search);
+#endif
+
 #ifdef TIMEIT
 	statusline(INFO, "Took: %.2f", (double)(clock() - start) / CLOCKS_PER_SEC);
 #endif
@@ -458,7 +783,7 @@ int replace_regexp(char *string, bool create)
 	while (*c != '\0') {
 		int num = (*(c + 1) - '0');
 
-		if (*c != '\\' || num < 1 || num > 9 || num > search_regexp.re_nsub) {
+		if (*c != '\\' || num < 1 || num > 9 || num > search_regexp->re_nsub) {
 			if (create)
 				*string++ = *c;
 			c++;
@@ -521,6 +846,237 @@ char *replace_line(const char *needle)
 	return copy;
 }
 
+#ifndef NANO_TINY
+/* Replace the occurrences of needle in the given line, starting at from_x.
+ * Occurrences must start before upto_x, or, when in_region is TRUE, must
+ * end at or before it.  Once a zero-length or BOL match has been replaced, the
+ * skipping stays on: each further search in a line then starts one character
+ * beyond the end of the preceding match, as with the one-by-one replacing.
+ * Return the number of replacements.  Pass back the rewritten line, and
+ * where the position upto_x has moved to. */
+size_t replace_in_line(linestruct *line, const char *needle, size_t from_x,
+						size_t upto_x, bool in_region, bool *skipping,
+						char **rewritten, size_t *new_upto_x)
+{
+	const char *data = line->data;
+	size_t length = strlen(data);
+	size_t room = length + 1, filled = 0, copied = 0;
+	size_t count = 0, scan = from_x;
+	char *text = NULL;
+
+	*new_upto_x = upto_x;
+
+	/* A regex replacement with subexpressions reads the current line. */
+	openfile->current = line;
+
+	while (scan <= length) {
+		const char *found = strstrwrapper(data, needle, data + scan);
+		size_t found_x, match_len, addition;
+
+		if (found == NULL)
+			break;
+
+		found_x = found - data;
+		match_len = ISSET(USE_REGEXP) ?
+						regmatches[0].rm_eo - regmatches[0].rm_so : strlen(needle);
+
+		if (in_region ? found_x + match_len > upto_x : found_x >= upto_x)
+			break;
+
+		addition = ISSET(USE_REGEXP) ? replace_regexp(NULL, FALSE) : strlen(answer);
+
+		if (text == NULL || filled + addition + (length - copied) + 1 > room) {
+			while (filled + addition + (length - copied) + 1 > room)
+				room *= 2;
+			text = nrealloc(text, room);
+		}
+
+		/* Copy the text in front of the match, and then the replacement. */
+		memcpy(text + filled, data + copied, found_x - copied);
+		filled += found_x - copied;
+
+		if (ISSET(USE_REGEXP))
+			replace_regexp(text + filled, TRUE);
+		else
+			strcpy(text + filled, answer);
+
+		/* When the end point lies within or after the match, shift it. */
+		if (upto_x != (size_t)-1 && found_x < upto_x) {
+			if (upto_x < found_x + match_len)
+				*new_upto_x = filled + addition;
+			else
+				*new_upto_x += addition - match_len;
+		}
+
+		filled += addition;
+		copied = found_x + match_len;
+		count++;
+
+		/* Don't find the same zero-length or BOL match again. */
+		if (match_len == 0 || (*needle == '^' && ISSET(USE_REGEXP)))
+			*skipping = TRUE;
+
+		if (*skipping) {
+			if (data[copied] == '\0')
+				break;
+			scan = copied + char_length(data + copied);
+		} else
+			scan = copied;
+	}
+
+	if (count > 0) {
+		strcpy(text + filled, data + copied);
+		*rewritten = text;
+	}
+
+	return count;
+}
+
+/* Do the same as replace_in_line(), but for a regex that checks for word
+ * boundaries: search each time in the line as changed by the preceding
+ * replacements, because the text in front of a match can matter. */
+size_t replace_in_line_stepwise(linestruct *line, const char *needle, size_t from_x,
+						size_t upto_x, bool in_region, bool *skipping,
+						char **rewritten, size_t *new_upto_x)
+{
+	char *original = line->data;
+	size_t count = 0, scan = from_x;
+
+	line->data = copy_of(original);
+	openfile->current = line;
+
+	while (scan <= strlen(line->data)) {
+		const char *found = strstrwrapper(line->data, needle, line->data + scan);
+		size_t match_len, length_change;
+		char *copy;
+
+		if (found == NULL)
+			break;
+
+		openfile->current_x = found - line->data;
+		match_len = regmatches[0].rm_eo - regmatches[0].rm_so;
+
+		if (in_region ? openfile->current_x + match_len > upto_x :
+						openfile->current_x >= upto_x)
+			break;
+
+		copy = replace_line(needle);
+		length_change = strlen(copy) - strlen(line->data);
+
+		/* When the end point lies within or after the match, shift it. */
+		if (upto_x != (size_t)-1 && openfile->current_x < upto_x) {
+			if (upto_x < openfile->current_x + match_len)
+				upto_x = openfile->current_x + match_len;
+			upto_x += length_change;
+		}
+
+		free(line->data);
+		line->data = copy;
+		scan = openfile->current_x + match_len + length_change;
+		count++;
+
+		if (match_len == 0 || *needle == '^')
+			*skipping = TRUE;
+
+		if (*skipping) {
+			if (line->data[scan] == '\0')
+				break;
+			scan += char_length(line->data + scan);
+		}
+	}
+
+	*new_upto_x = upto_x;
+
+	if (count > 0)
+		*rewritten = line->data;
+	else
+		free(line->data);
+
+	line->data = original;
+
+	return count;
+}
+
+/* Replace in one go all occurrences of needle from the current position
+ * onward until the given end point -- wrapping around at the bottom of the
+ * buffer when the end point lies before the current position, except when
+ * in_region is TRUE.  Each affected line is rewritten just once (except the
+ * starting line, when it gets revisited), and the whole operation becomes
+ * a single undo item.  Adjust the x position of the end point for the
+ * changes, and return the number of replacements. */
+ssize_t replace_all_in_one_go(const char *needle, const linestruct *stop,
+								size_t *stop_x, bool in_region)
+{
+	linestruct *line = openfile->current;
+	linestruct *first_line = line;
+	size_t from_x = openfile->current_x;
+	bool wrapped = (in_region || lineno_of(line) < lineno_of(stop) ||
+						(line == stop && from_x < *stop_x));
+		/* Whether the end point can be reached without wrapping. */
+	bool first_changed = FALSE;
+	bool skipping = FALSE;
+	bool stepwise = ISSET(USE_REGEXP) && (strstr(needle, "\\<") ||
+						strstr(needle, "\\>") || strstr(needle, "\\b") ||
+						strstr(needle, "\\B"));
+		/* Whether the regex can depend on what precedes a match. */
+	clock_t start = clock();
+	ssize_t numreplaced = 0;
+
+	add_undo(REPLACE_ALL, NULL);
+
+	while (TRUE) {
+		bool at_end = (wrapped && line == stop);
+		size_t new_stop_x;
+		char *rewritten;
+		size_t count = (stepwise ? replace_in_line_stepwise : replace_in_line)(
+								line, needle, from_x, at_end ? *stop_x : (size_t)-1,
+								in_region, &skipping, &rewritten, &new_stop_x);
+
+		if (count > 0) {
+			if (line == openfile->filebot && *answer != '\0')
+				openfile->current_undo->xflags |= INCLUDED_LAST_LINE;
+
+			openfile->totsize += mbstrlen(rewritten) - chars_in(line);
+
+			/* For a revisited starting line, the undo item has the original. */
+			if (line != first_line || !first_changed)
+				update_multiline_undo(lineno_of(line), line->data);
+
+			free_data(line->data);
+
+			line->data = rewritten;
+			forget_the_counts_of(line);
+			first_changed |= (line == first_line);
+
+			if (ISSET(SOFTWRAP))
+				compute_the_extra_rows_of(line);
+
+			numreplaced += count;
+		}
+
+		if (at_end) {
+			*stop_x = new_stop_x;
+			break;
+		}
+
+		from_x = 0;
+		line = line->next;
+
+		if (line == NULL) {
+			line = openfile->filetop;
+			wrapped = TRUE;
+		}
+	}
+
+	set_modified();
+	as_an_at = TRUE;
+
+	batch_duration = clock() - start;
+
+	return numreplaced;
+}
+#endif /* !NANO_TINY */
+
 /* Step through each occurrence of the search string and prompt the user
  * before replacing it.  We seek for needle, and replace it with answer.
  * The parameters real_current and real_current_x are needed in order to
@@ -574,8 +1130,8 @@ ssize_t do_replace_loop(const char *needle, bool whole_word_only,
 
 #ifndef NANO_TINY
 		/* An occurrence outside of the marked region means we're done. */
-		if (was_mark && (openfile->current->lineno > bot->lineno ||
-								openfile->current->lineno < top->lineno ||
+		if (was_mark && (lineno_of(openfile->current) > lineno_of(bot) ||
+								lineno_of(openfile->current) < lineno_of(top) ||
 								(openfile->current == bot &&
 								openfile->current_x + match_len > bot_x) ||
 								(openfile->current == top &&
@@ -606,6 +1162,24 @@ ssize_t do_replace_loop(const char *needle, bool whole_word_only,
 			else if (choice == 2)
 				replaceall = TRUE;
 
+#ifndef NANO_TINY
+			/* When replacing all remaining occurrences in the forward
+			 * direction, do it in one go, up to where we started. */
+			if (replaceall && !whole_word_only && !ISSET(BACKWARDS_SEARCH)) {
+				if (!was_mark)
+					numreplaced += replace_all_in_one_go(needle, real_current,
+															real_current_x, FALSE);
+				else if (right_side_up) {
+					numreplaced += replace_all_in_one_go(needle, bot, real_current_x, TRUE);
+					bot_x = *real_current_x;
+				} else {
+					numreplaced += replace_all_in_one_go(needle, bot, &openfile->mark_x, TRUE);
+					bot_x = openfile->mark_x;
+				}
+				break;
+			}
+#endif
+
 			/* When "No" or moving backwards, the search routine should
 			 * first move one character further before continuing. */
 			skipone = (choice == 0 || ISSET(BACKWARDS_SEARCH));
@@ -661,13 +1235,14 @@ ssize_t do_replace_loop(const char *needle, bool whole_word_only,
 				openfile->current_x += match_len + length_change;
 
 			/* Update the file size, and put the changed line into place. */
-			openfile->totsize += mbstrlen(copy) - mbstrlen(openfile->current->data);
-			free(openfile->current->data);
+			openfile->totsize += mbstrlen(copy) - chars_in(openfile->current);
+			free_data(openfile->current->data);
 			openfile->current->data = copy;
+			forget_the_counts_of(openfile->current);
 
 #ifndef NANO_TINY
 			if (ISSET(SOFTWRAP))
-				openfile->current->extrarows = extra_chunks_in(openfile->current);
+				compute_the_extra_rows_of(openfile->current);
 #endif
 			set_modified();
 			as_an_at = TRUE;
@@ -726,6 +1301,10 @@ void ask_for_and_do_replacements(void)
 	} else if (response > 0)
 		return;
 
+#ifndef NANO_TINY
+	batch_duration = 0;
+#endif
+
 	numreplaced = do_replace_loop(last_search, FALSE, beginline, &begin_x);
 
 	/* Restore where we were. */
@@ -735,6 +1314,14 @@ void ask_for_and_do_replacements(void)
 	openfile->current_x = begin_x;
 	refresh_needed = TRUE;
 
+#ifndef NANO_TINY
+	/* When replacing in one go took noticeable time, report the speed. */
+	if (numreplaced > 0 && batch_duration > CLOCKS_PER_SEC / 10)
+		statusline(REMARK, P_("Replaced %zd occurrence (%.0f per second)",
+				"Replaced %zd occurrences (%.0f per second)", numreplaced), numreplaced,
+				numreplaced * (double)CLOCKS_PER_SEC / batch_duration);
+	else
+#endif
 	if (numreplaced >= 0)
 		statusline(REMARK, P_("Replaced %zd occurrence",
 				"Replaced %zd occurrences", numreplaced), numreplaced);
@@ -743,9 +1330,10 @@ void ask_for_and_do_replacements(void)
 /* Go to the specified line and x position. */
 void goto_line_posx(ssize_t line, size_t pos_x)
 {
-	for (openfile->current = openfile->filetop; line > 1 &&
-				openfile->current != openfile->filebot; line--)
-		openfile->current = openfile->current->next;
+	if (line < lineno_of(openfile->filebot))
+		openfile->current = line_from_number(line);
+	else
+		openfile->current = openfile->filebot;
 
 	openfile->current_x = pos_x;
 	openfile->placewewant = xplustabs();
@@ -789,7 +1377,7 @@ void do_gotolinecolumn(ssize_t line, ssize_t column, bool retain_answer,
 		}
 	} else {
 		if (line == 0)
-			line = openfile->current->lineno;
+			line = lineno_of(openfile->current);
 
 		if (column == 0)
 			column = openfile->placewewant + 1;
@@ -797,14 +1385,15 @@ void do_gotolinecolumn(ssize_t line, ssize_t column, bool retain_answer,
 
 	/* Take a negative line number to mean: from the end of the file. */
 	if (line < 0)
-		line = openfile->filebot->lineno + line + 1;
+		line = lineno_of(openfile->filebot) + line + 1;
 	if (line < 1)
 		line = 1;
 
-	/* Iterate to the requested line. */
-	for (openfile->current = openfile->filetop; line > 1 &&
-				openfile->current != openfile->filebot; line--)
-		openfile->current = openfile->current->next;
+	/* Look up the requested line, or take the last one. */
+	if (line < lineno_of(openfile->filebot))
+		openfile->current = line_from_number(line);
+	else
+		openfile->current = openfile->filebot;
 
 	/* Take a negative column number to mean: from the end of the line. */
 	if (column < 0)
@@ -838,8 +1427,8 @@ void do_gotolinecolumn(ssize_t line, ssize_t column, bool retain_answer,
 								editwinrows / 2, &currentline, &leftedge);
 		} else
 #endif
-			rows_from_tail = openfile->filebot->lineno -
-								openfile->current->lineno;
+			rows_from_tail = lineno_of(openfile->filebot) -
+								lineno_of(openfile->current);
 
 		/* If the target line is close to the tail of the file, put the last
 		 * line or chunk on the bottom line of the screen; otherwise, just
@@ -855,15 +1444,17 @@ void do_gotolinecolumn(ssize_t line, ssize_t column, bool retain_answer,
 /* Go to the specified line and column, asking for them beforehand. */
 void do_gotolinecolumn_void(void)
 {
-	do_gotolinecolumn(openfile->current->lineno,
+	do_gotolinecolumn(lineno_of(openfile->current),
 						openfile->placewewant + 1, FALSE, TRUE);
 }
 
 #ifndef NANO_TINY
 /* Search, starting from the current position, for any of the two characters
  * in bracket_pair.  If reverse is TRUE, search backwards, otherwise forwards.
+ * When leaving a line, skip straight to the line where the given balance of
+ * brackets can drop to zero, adjusting the balance for the skipped lines.
  * Return TRUE when one of the brackets was found, and FALSE otherwise. */
-bool find_a_bracket(bool reverse, const char *bracket_pair)
+bool find_a_bracket(bool reverse, const char *bracket_pair, size_t *balance)
 {
 	linestruct *line = openfile->current;
 	const char *pointer, *found;
@@ -871,7 +1462,7 @@ bool find_a_bracket(bool reverse, const char *bracket_pair)
 	if (reverse) {
 		/* First step away from the current bracket. */
 		if (openfile->current_x == 0) {
-			line = line->prev;
+			line = line_that_balances(line, TRUE, balance);
 			if (line == NULL)
 				return FALSE;
 			pointer = line->data + strlen(line->data);
@@ -880,7 +1471,7 @@ bool find_a_bracket(bool reverse, const char *bracket_pair)
 
 		/* Now seek for any of the two brackets we are interested in. */
 		while (!(found = mbrevstrpbrk(line->data, bracket_pair, pointer))) {
-			line = line->prev;
+			line = line_that_balances(line, TRUE, balance);
 			if (line == NULL)
 				return FALSE;
 			pointer = line->data + strlen(line->data);
@@ -889,7 +1480,7 @@ bool find_a_bracket(bool reverse, const char *bracket_pair)
 		pointer = line->data + step_right(line->data, openfile->current_x);
 
 		while (!(found = mbstrpbrk(pointer, bracket_pair))) {
-			line = line->next;
+			line = line_that_balances(line, FALSE, balance);
 			if (line == NULL)
 				return FALSE;
 			pointer = line->data;
@@ -958,12 +1549,20 @@ void do_find_bracket(void)
 	ch_len = char_length(ch);
 	wanted_ch_len = char_length(wanted_ch);
 
-	/* Copy the two complementary brackets into a single string. */
-	strncpy(bracket_pair, ch, ch_len);
-	strncpy(bracket_pair + ch_len, wanted_ch, wanted_ch_len);
+	/* Copy the two complementary brackets into a single string, first the
+	 * opening one, and have the bracket depths be about these two. */
+	if (reverse) {
+		strncpy(bracket_pair, wanted_ch, wanted_ch_len);
+		strncpy(bracket_pair + wanted_ch_len, ch, ch_len);
+	} else {
+		strncpy(bracket_pair, ch, ch_len);
+		strncpy(bracket_pair + ch_len, wanted_ch, wanted_ch_len);
+	}
 	bracket_pair[ch_len + wanted_ch_len] = '\0';
 
-	while (find_a_bracket(reverse, bracket_pair)) {
+	aim_the_depths_at(bracket_pair);
+
+	while (find_a_bracket(reverse, bracket_pair, &balance)) {
 		/* Increment/decrement balance for an identical/other bracket. */
 		balance += (strncmp(openfile->current->data + openfile->current_x,
 							ch, ch_len) == 0) ? 1 : -1;
@@ -40,10 +40,30 @@
 #endif
 
 #ifdef ENABLE_WORDCOMPLETION
-static int pletion_x = 0;
-		/* The x position in pletion_line of the last found completion. */
-static completion_word *list_of_completions;
-		/* A linked list of the completions that have been attempted. */
+static wordstruct **known_words = NULL;
+		/* A hash table of the words in the open buffers, keyed by their text. */
+static size_t known_size = 0;
+		/* The number of slots in the above table, always a power of two. */
+static size_t known_count = 0;
+		/* The number of words in the table, including the ones that no longer occur. */
+static size_t vanished_count = 0;
+		/* The number of words in the table that no longer occur anywhere. */
+static wordstruct **alphabet = NULL;
+		/* The known words in sorted order, followed by any words added since. */
+static size_t sorted_count = 0;
+		/* The number of words at the start of the above array that are sorted. */
+static size_t attempts = 0;
+		/* The number of fresh completion attempts, for stamping changed words. */
+static wordstruct **candidates = NULL;
+		/* The possible completions of the current fragment, best first. */
+static size_t candidate_count = 0;
+		/* The number of the above candidates. */
+static size_t pletion_x = 0;
+		/* The index of the next candidate to try. */
+#endif
+#ifndef NANO_TINY
+static FILE *spill_file = NULL;
+		/* The temporary file that holds the data of old undo items. */
 #endif
 
 #ifndef NANO_TINY
@@ -103,11 +123,12 @@ void indent_a_line(linestruct *line, char *indentation)
 	line->data = nrealloc(line->data, length + indent_len + 1);
 	memmove(line->data + indent_len, line->data, length + 1);
 	memcpy(line->data, indentation, indent_len);
+	forget_the_counts_of(line);
 
 	openfile->totsize += indent_len;
 
 	if (ISSET(SOFTWRAP))
-		line->extrarows = extra_chunks_in(line);
+		compute_the_extra_rows_of(line);
 
 	/* Compensate for the change in the current line. */
 	if (line == openfile->mark && openfile->mark_x > 0)
@@ -161,7 +182,7 @@ void do_indent(void)
 		char *real_indent = (line->data[0] == '\0') ? "" : indentation;
 
 		indent_a_line(line, real_indent);
-		update_multiline_undo(line->lineno, real_indent);
+		update_multiline_undo(lineno_of(line), real_indent);
 	}
 
 	free(indentation);
@@ -233,12 +254,14 @@ void unindent_a_line(linestruct *line, size_t indent_len)
 		return;
 
 	/* Remove the first tab's worth of whitespace from this line. */
+	make_text_private(line);
 	memmove(line->data, line->data + indent_len, length - indent_len + 1);
+	forget_the_counts_of(line);
 
 	openfile->totsize -= indent_len;
 
 	if (ISSET(SOFTWRAP))
-		line->extrarows = extra_chunks_in(line);
+		compute_the_extra_rows_of(line);
 
 	/* Adjust the positions of mark and cursor, when they are affected. */
 	compensate_leftward(line, indent_len);
@@ -270,7 +293,7 @@ void do_unindent(void)
 		char *indentation = measured_copy(line->data, indent_len);
 
 		unindent_a_line(line, indent_len);
-		update_multiline_undo(line->lineno, indentation);
+		update_multiline_undo(lineno_of(line), indentation);
 
 		free(indentation);
 	}
@@ -295,8 +318,8 @@ void handle_indent_action(undostruct *u, bool undoing, bool add_indent)
 		goto_line_posx(u->head_lineno, u->head_x);
 
 	/* For each line in the group, add or remove the individual indent. */
-	while (line != NULL && line->lineno <= group->bottom_line) {
-		char *blanks = group->indentations[line->lineno - group->top_line];
+	while (line != NULL && lineno_of(line) <= group->bottom_line) {
+		char *blanks = group->indentations[lineno_of(line) - group->top_line];
 
 		if (undoing ^ add_indent)
 			indent_a_line(line, blanks);
@@ -312,6 +335,34 @@ void handle_indent_action(undostruct *u, bool undoing, bool add_indent)
 
 	refresh_needed = TRUE;
 }
+
+/* Perform an undo or redo for a replacing of all occurrences: exchange the
+ * text of each affected line with the text that the undo item holds for it. */
+void handle_replace_all_action(undostruct *u)
+{
+	for (groupstruct *group = u->grouping; group != NULL; group = group->next) {
+		linestruct *line = line_from_number(group->top_line);
+
+		for (ssize_t index = 0; index <= group->bottom_line - group->top_line; index++) {
+			char *data = group->indentations[index];
+
+			/* The text of the line may live in the arena, so the undo item
+			 * gets a private copy of it, as the item frees its texts. */
+			group->indentations[index] = copy_of(line->data);
+			free_data(line->data);
+			line->data = data;
+			forget_the_counts_of(line);
+
+			if (ISSET(SOFTWRAP))
+				compute_the_extra_rows_of(line);
+
+			line = line->next;
+		}
+	}
+
+	goto_line_posx(u->head_lineno, u->head_x);
+	refresh_needed = TRUE;
+}
 #endif /* !NANO_TINY */
 
 #ifdef ENABLE_COMMENT
@@ -340,6 +391,7 @@ bool comment_line(undo_type action, linestruct *line, const char *comment_seq)
 		memmove(line->data, comment_seq, pre_len);
 		if (post_len > 0)
 			memmove(line->data + pre_len + line_len, post_seq, post_len + 1);
+		forget_the_counts_of(line);
 
 		openfile->totsize += pre_len + post_len;
 
@@ -362,9 +414,11 @@ bool comment_line(undo_type action, linestruct *line, const char *comment_seq)
 			return TRUE;
 
 		/* Erase the comment prefix by moving the non-comment part. */
+		make_text_private(line);
 		memmove(line->data, line->data + pre_len, line_len - pre_len);
 		/* Truncate the postfix if there was one. */
 		line->data[line_len - pre_len - post_len] = '\0';
+		forget_the_counts_of(line);
 
 		openfile->totsize -= pre_len + post_len;
 
@@ -431,9 +485,9 @@ void do_comment(void)
 		if (comment_line(action, line, comment_seq)) {
 #ifndef NANO_TINY
 			if (ISSET(SOFTWRAP))
-				line->extrarows = extra_chunks_in(line);
+				compute_the_extra_rows_of(line);
 #endif
-			update_multiline_undo(line->lineno, "");
+			update_multiline_undo(lineno_of(line), "");
 		}
 	}
 
@@ -455,7 +509,7 @@ void handle_comment_action(undostruct *u, bool undoing, bool add_comment)
 	while (group) {
 		linestruct *line = line_from_number(group->top_line);
 
-		while (line != NULL && line->lineno <= group->bottom_line) {
+		while (line != NULL && lineno_of(line) <= group->bottom_line) {
 			comment_line(undoing ^ add_comment ?
 								COMMENT : UNCOMMENT, line, u->strdata);
 			line = line->next;
@@ -526,6 +580,9 @@ void do_undo(void)
 		return;
 	}
 
+	if (u->spilled_at >= 0)
+		fetch_undo_item(u);
+
 	if (u->type <= REPLACE)
 		line = line_from_number(u->tail_lineno);
 
@@ -536,6 +593,7 @@ void do_undo(void)
 		undidmsg = _("addition");
 		if ((u->xflags & INCLUDED_LAST_LINE) && !ISSET(NO_NEWLINES))
 			remove_magicline();
+		make_text_private(line);
 		memmove(line->data + u->head_x, line->data + u->head_x + strlen(u->strdata),
 						strlen(line->data + u->head_x) - strlen(u->strdata) + 1);
 		goto_line_posx(u->head_lineno, u->head_x);
@@ -551,7 +609,9 @@ void do_undo(void)
 								strlen(&u->strdata[regain_from_x]) + 1);
 		strcat(line->data, &u->strdata[regain_from_x]);
 		line->has_anchor |= line->next->has_anchor;
+		discount_the_extra_rows(line->next, line->next);
 		unlink_node(line->next);
+		openfile->totlines--;
 		renumber_from(line);
 		goto_line_posx(u->head_lineno, original_x);
 		break;
@@ -562,7 +622,7 @@ void do_undo(void)
 		strncpy(data, line->data, u->head_x);
 		strcpy(&data[u->head_x], u->strdata);
 		strcpy(&data[u->head_x + strlen(u->strdata)], &line->data[u->head_x]);
-		free(line->data);
+		free_data(line->data);
 		line->data = data;
 		goto_line_posx(u->tail_lineno, u->tail_x);
 		break;
@@ -572,15 +632,17 @@ void do_undo(void)
 		 * and the nonewlines flag isn't set, do not re-add a newline that
 		 * wasn't actually deleted; just position the cursor. */
 		if ((u->xflags & WAS_BACKSPACE_AT_EOF) && !ISSET(NO_NEWLINES)) {
-			goto_line_posx(openfile->filebot->lineno, 0);
+			goto_line_posx(lineno_of(openfile->filebot), 0);
 			break;
 		}
+		make_text_private(line);
 		line->data[u->tail_x] = '\0';
 		if (ISSET(SOFTWRAP))
-			line->extrarows = extra_chunks_in(line);
+			compute_the_extra_rows_of(line);
 		intruder = make_new_node(line);
 		intruder->data = copy_of(u->strdata);
 		splice_node(line, intruder);
+		openfile->totlines++;
 		renumber_from(intruder);
 		goto_line_posx(u->head_lineno, u->head_x);
 		break;
@@ -635,6 +697,12 @@ void do_undo(void)
 							openfile->filebot != openfile->current)
 			remove_magicline();
 		break;
+	case REPLACE_ALL:
+		undidmsg = _("replacement");
+		if ((u->xflags & INCLUDED_LAST_LINE) && !ISSET(NO_NEWLINES))
+			remove_magicline();
+		handle_replace_all_action(u);
+		break;
 	case COUPLE_BEGIN:
 		undidmsg = u->strdata;
 		goto_line_posx(u->head_lineno, u->head_x);
@@ -671,6 +739,10 @@ void do_undo(void)
 		break;
 	}
 
+	/* The simple actions change the text of just the one line. */
+	if (line != NULL)
+		forget_the_counts_of(line);
+
 	if (undidmsg && !pletion_line)
 		statusline(HUSH, _("Undid %s"), undidmsg);
 
@@ -680,12 +752,13 @@ void do_undo(void)
 	openfile->placewewant = xplustabs();
 
 	if (ISSET(SOFTWRAP))
-		openfile->current->extrarows = extra_chunks_in(openfile->current);
+		compute_the_extra_rows_of(openfile->current);
 
 	openfile->totsize = u->wassize;
 
 	/* When at the point where the file was last saved, unset "Modified". */
 	if (openfile->current_undo == openfile->last_saved) {
+		openfile->version++;
 		openfile->modified = FALSE;
 		titlebar(NULL);
 	} else
@@ -709,6 +782,9 @@ void do_redo(void)
 	while (u->next != openfile->current_undo)
 		u = u->next;
 
+	if (u->spilled_at >= 0)
+		fetch_undo_item(u);
+
 	if (u->type <= REPLACE)
 		line = line_from_number(u->tail_lineno);
 
@@ -721,24 +797,27 @@ void do_redo(void)
 		strncpy(data, line->data, u->head_x);
 		strcpy(&data[u->head_x], u->strdata);
 		strcpy(&data[u->head_x + strlen(u->strdata)], &line->data[u->head_x]);
-		free(line->data);
+		free_data(line->data);
 		line->data = data;
 		goto_line_posx(u->tail_lineno, u->tail_x);
 		break;
 	case ENTER:
 		redidmsg = _("line break");
+		make_text_private(line);
 		line->data[u->head_x] = '\0';
 		if (ISSET(SOFTWRAP))
-			line->extrarows = extra_chunks_in(line);
+			compute_the_extra_rows_of(line);
 		intruder = make_new_node(line);
 		intruder->data = copy_of(u->strdata);
 		splice_node(line, intruder);
+		openfile->totlines++;
 		renumber_from(intruder);
 		goto_line_posx(u->head_lineno + 1, u->tail_x);
 		break;
 	case BACK:
 	case DEL:
 		redidmsg = _("deletion");
+		make_text_private(line);
 		memmove(line->data + u->head_x, line->data + u->head_x + strlen(u->strdata),
 						strlen(line->data + u->head_x) - strlen(u->strdata) + 1);
 		goto_line_posx(u->head_lineno, u->head_x);
@@ -754,7 +833,9 @@ void do_redo(void)
 		}
 		line->data = nrealloc(line->data, strlen(line->data) + strlen(u->strdata) + 1);
 		strcat(line->data, u->strdata);
+		discount_the_extra_rows(line->next, line->next);
 		unlink_node(line->next);
+		openfile->totlines--;
 		renumber_from(line);
 		goto_line_posx(u->tail_lineno, u->tail_x);
 		break;
@@ -802,6 +883,12 @@ void do_redo(void)
 		free_lines(u->cutbuffer);
 		u->cutbuffer = NULL;
 		break;
+	case REPLACE_ALL:
+		redidmsg = _("replacement");
+		if ((u->xflags & INCLUDED_LAST_LINE) && !ISSET(NO_NEWLINES))
+			new_magicline();
+		handle_replace_all_action(u);
+		break;
 	case COUPLE_BEGIN:
 		openfile->current_undo = u;
 		do_redo();
@@ -836,6 +923,10 @@ void do_redo(void)
 		break;
 	}
 
+	/* The simple actions change the text of just the one line. */
+	if (line != NULL)
+		forget_the_counts_of(line);
+
 	if (redidmsg)
 		statusline(HUSH, _("Redid %s"), redidmsg);
 
@@ -845,12 +936,13 @@ void do_redo(void)
 	openfile->placewewant = xplustabs();
 
 	if (ISSET(SOFTWRAP))
-		openfile->current->extrarows = extra_chunks_in(openfile->current);
+		compute_the_extra_rows_of(openfile->current);
 
 	openfile->totsize = u->newsize;
 
 	/* When at the point where the file was last saved, unset "Modified". */
 	if (openfile->current_undo == openfile->last_saved) {
+		openfile->version++;
 		openfile->modified = FALSE;
 		titlebar(NULL);
 	} else if (!suppress_modification)
@@ -899,7 +991,9 @@ void do_enter(void)
 #endif
 
 	/* Make the current line end at the cursor position. */
+	make_text_private(openfile->current);
 	openfile->current->data[openfile->current_x] = '\0';
+	forget_the_counts_of(openfile->current);
 
 #ifndef NANO_TINY
 	add_undo(ENTER, NULL);
@@ -912,13 +1006,14 @@ void do_enter(void)
 	}
 
 	if (ISSET(SOFTWRAP)) {
-		openfile->current->extrarows = extra_chunks_in(openfile->current);
-		newnode->extrarows = extra_chunks_in(newnode);
+		compute_the_extra_rows_of(openfile->current);
+		compute_the_extra_rows_of(newnode);
 	}
 #endif
 
 	/* Insert the newly created line after the current one and renumber. */
 	splice_node(openfile->current, newnode);
+	openfile->totlines++;
 	renumber_from(newnode);
 
 	/* Put the cursor on the new line, after any automatic whitespace. */
@@ -948,7 +1043,8 @@ void discard_until(const undostruct *thisitem)
 
 	while (dropit != NULL && dropit != thisitem) {
 		openfile->undotop = dropit->next;
-		free(dropit->strdata);
+		openfile->undoweight -= dropit->weight;
+		free_data(dropit->strdata - dropit->dataslack);
 		free_lines(dropit->cutbuffer);
 		group = dropit->grouping;
 		while (group != NULL) {
@@ -969,6 +1065,187 @@ void discard_until(const undostruct *thisitem)
 	openfile->last_action = OTHER;
 }
 
+/* Return roughly how many bytes of memory the given undo item takes up. */
+size_t weight_of(const undostruct *u)
+{
+	size_t weight = sizeof(undostruct);
+
+	if (u->strdata != NULL)
+		weight += (u->dataroom > 0) ? u->dataroom : strlen(u->strdata) + 1;
+
+	for (linestruct *line = u->cutbuffer; line != NULL; line = line->next)
+		weight += sizeof(linestruct) + strlen(line->data) + 1;
+
+	for (groupstruct *group = u->grouping; group != NULL; group = group->next) {
+		if (group->indentations == NULL)
+			continue;
+
+		for (ssize_t index = 0; index <= group->bottom_line - group->top_line; index++)
+			weight += sizeof(char *) + strlen(group->indentations[index]) + 1;
+	}
+
+	return weight;
+}
+
+/* Write the given string (which may be NULL) to the spill file,
+ * preceded by its length. */
+void spill_string(const char *text)
+{
+	size_t length = (text == NULL) ? (size_t)-1 : strlen(text);
+
+	fwrite(&length, sizeof(size_t), 1, spill_file);
+
+	if (text != NULL)
+		fwrite(text, 1, length, spill_file);
+}
+
+/* Read back from the spill file a string that was written by spill_string(). */
+char *unspill_string(void)
+{
+	size_t length;
+	char *text;
+
+	if (fread(&length, sizeof(size_t), 1, spill_file) != 1)
+		die(_("Could not read back undo data\n"));
+
+	if (length == (size_t)-1)
+		return NULL;
+
+	text = nmalloc(length + 1);
+
+	if (fread(text, 1, length, spill_file) != length)
+		die(_("Could not read back undo data\n"));
+
+	text[length] = '\0';
+
+	return text;
+}
+
+/* Move the bulky data of the given undo item (its string, its copy of the
+ * cutbuffer, and the indentations of its groups) to the spill file, and
+ * free it.  Return FALSE when the data could not be written. */
+bool spill_undo_item(undostruct *u)
+{
+	size_t count = 0;
+	off_t place;
+
+	if (spill_file == NULL)
+		spill_file = tmpfile();
+
+	if (spill_file == NULL || fseeko(spill_file, 0, SEEK_END) != 0 ||
+								(place = ftello(spill_file)) < 0)
+		return FALSE;
+
+	spill_string(u->strdata);
+
+	for (linestruct *line = u->cutbuffer; line != NULL; line = line->next)
+		count++;
+
+	fwrite(&count, sizeof(size_t), 1, spill_file);
+
+	for (linestruct *line = u->cutbuffer; line != NULL; line = line->next)
+		spill_string(line->data);
+
+	for (groupstruct *group = u->grouping; group != NULL; group = group->next)
+		for (ssize_t index = 0; index <= group->bottom_line - group->top_line; index++)
+			spill_string(group->indentations[index]);
+
+	/* When something went wrong, keep the data in memory. */
+	if (fflush(spill_file) != 0 || ferror(spill_file)) {
+		clearerr(spill_file);
+		return FALSE;
+	}
+
+	free_data(u->strdata - u->dataslack);
+	u->strdata = NULL;
+	u->dataroom = 0;
+	u->dataslack = 0;
+
+	free_lines(u->cutbuffer);
+	u->cutbuffer = NULL;
+
+	for (groupstruct *group = u->grouping; group != NULL; group = group->next) {
+		free_chararray(group->indentations, group->bottom_line - group->top_line + 1);
+		group->indentations = NULL;
+	}
+
+	u->spilled_at = place;
+
+	return TRUE;
+}
+
+/* Read the bulky data of the given undo item back from the spill file. */
+void fetch_undo_item(undostruct *u)
+{
+	linestruct *line = NULL;
+	size_t count;
+
+	if (fseeko(spill_file, u->spilled_at, SEEK_SET) != 0)
+		die(_("Could not read back undo data\n"));
+
+	u->strdata = unspill_string();
+
+	if (fread(&count, sizeof(size_t), 1, spill_file) != 1)
+		die(_("Could not read back undo data\n"));
+
+	while (count-- > 0) {
+		if (line == NULL) {
+			u->cutbuffer = make_new_node(NULL);
+			line = u->cutbuffer;
+		} else {
+			line->next = make_new_node(line);
+			line = line->next;
+		}
+		line->data = unspill_string();
+	}
+
+	for (groupstruct *group = u->grouping; group != NULL; group = group->next) {
+		ssize_t amount = group->bottom_line - group->top_line + 1;
+
+		group->indentations = nmalloc(amount * sizeof(char *));
+
+		for (ssize_t index = 0; index < amount; index++)
+			group->indentations[index] = unspill_string();
+	}
+
+	u->spilled_at = -1;
+
+	/* The item is in memory again, so it counts again. */
+	u->weight = weight_of(u);
+	openfile->undoweight += u->weight;
+}
+
+/* When the undo items of the current buffer take up more memory than the
+ * budget allows, move the data of the oldest ones to the spill file until
+ * the remaining ones take up at most half of the budget.  The current item
+ * and the ones that can be redone are left alone. */
+void keep_undo_within_budget(void)
+{
+	size_t budget = (size_t)undo_budget * 1024 * 1024;
+	bool older = FALSE;
+	size_t kept = 0;
+
+	if (undo_budget == 0 || openfile->undoweight <= budget)
+		return;
+
+	for (undostruct *u = openfile->undotop; u != NULL; u = u->next) {
+		if (u->weight > 0) {
+			kept += u->weight;
+
+			if (older && kept > budget / 2) {
+				if (!spill_undo_item(u))
+					return;
+
+				openfile->undoweight -= u->weight;
+				u->weight = 0;
+			}
+		}
+
+		if (u == openfile->current_undo)
+			older = TRUE;
+	}
+}
+
 /* Add a new undo item of the given type to the top of the current pile. */
 void add_undo(undo_type action, const char *message)
 {
@@ -978,15 +1255,20 @@ void add_undo(undo_type action, const char *message)
 	/* Initialize the newly allocated undo item. */
 	u->type = action;
 	u->strdata = NULL;
+	u->datalength = 0;
+	u->dataroom = 0;
+	u->dataslack = 0;
 	u->cutbuffer = NULL;
-	u->head_lineno = thisline->lineno;
+	u->head_lineno = lineno_of(thisline);
 	u->head_x = openfile->current_x;
-	u->tail_lineno = thisline->lineno;
+	u->tail_lineno = lineno_of(thisline);
 	u->tail_x = openfile->current_x;
 	u->wassize = openfile->totsize;
 	u->newsize = openfile->totsize;
 	u->grouping = NULL;
 	u->xflags = 0;
+	u->spilled_at = -1;
+	u->weight = 0;
 
 	/* Blow away any undone items. */
 	discard_until(openfile->current_undo);
@@ -1030,6 +1312,8 @@ void add_undo(undo_type action, const char *message)
 			int charlen = char_length(thisline->data + u->head_x);
 
 			u->strdata = measured_copy(thisline->data + u->head_x, charlen);
+			u->datalength = charlen;
+			u->dataroom = charlen + 1;
 			if (u->type == BACK)
 				u->tail_x += charlen;
 			break;
@@ -1037,7 +1321,7 @@ void add_undo(undo_type action, const char *message)
 		action = JOIN;
 		if (thisline->next != NULL) {
 			if (u->type == BACK) {
-				u->head_lineno = thisline->next->lineno;
+				u->head_lineno = lineno_of(thisline->next);
 				u->head_x = 0;
 			}
 			u->strdata = copy_of(thisline->next->data);
@@ -1061,15 +1345,15 @@ void add_undo(undo_type action, const char *message)
 	case CUT:
 		if (openfile->mark) {
 			if (mark_is_before_cursor()){
-				u->head_lineno = openfile->mark->lineno;
+				u->head_lineno = lineno_of(openfile->mark);
 				u->head_x = openfile->mark_x;
 				u->xflags |= MARK_WAS_SET;
 			} else {
-				u->tail_lineno = openfile->mark->lineno;
+				u->tail_lineno = lineno_of(openfile->mark);
 				u->tail_x = openfile->mark_x;
 				u->xflags |= (MARK_WAS_SET | CURSOR_WAS_AT_HEAD);
 			}
-			if (u->tail_lineno == openfile->filebot->lineno)
+			if (u->tail_lineno == lineno_of(openfile->filebot))
 				u->xflags |= INCLUDED_LAST_LINE;
 		} else if (!ISSET(CUT_FROM_CURSOR)) {
 			/* The entire line is being cut regardless of the cursor position. */
@@ -1085,6 +1369,8 @@ void add_undo(undo_type action, const char *message)
 		if (thisline == openfile->filebot)
 			u->xflags |= INCLUDED_LAST_LINE;
 		break;
+	case REPLACE_ALL:
+		break;
 	case COUPLE_BEGIN:
 		u->tail_lineno = openfile->current_y;
 		/* Fall-through. */
@@ -1102,6 +1388,13 @@ void add_undo(undo_type action, const char *message)
 		die("Bad undo type -- please report a bug\n");
 	}
 
+	/* The item underneath the new one is complete now, so weigh it. */
+	if (u->next != NULL && u->next->weight == 0 && u->next->spilled_at < 0) {
+		u->next->weight = weight_of(u->next);
+		openfile->undoweight += u->next->weight;
+		keep_undo_within_budget();
+	}
+
 	openfile->last_action = action;
 }
 
@@ -1139,12 +1432,41 @@ void update_multiline_undo(ssize_t lineno, char *indentation)
 	u->newsize = openfile->totsize;
 }
 
+/* Make sure that the string of the given undo item has room for extra more
+ * bytes, either after it or, when in_front is TRUE, before it.  The room is
+ * doubled whenever it runs out, so that a long run of typing or deleting
+ * costs a constant amount of copying per keystroke. */
+void make_room_for(undostruct *u, size_t extra, bool in_front)
+{
+	size_t needed = u->datalength + extra + 1;
+	size_t slack;
+	char *storage;
+
+	if (in_front ? (u->dataslack >= extra) : (u->dataslack + needed <= u->dataroom))
+		return;
+
+	storage = nmalloc(2 * needed);
+
+	/* When growing at the front, put the string at the end of the new room. */
+	slack = in_front ? 2 * needed - u->datalength - 1 : 0;
+
+	if (u->strdata != NULL) {
+		memcpy(storage + slack, u->strdata, u->datalength + 1);
+		free_data(u->strdata - u->dataslack);
+	} else
+		storage[slack] = '\0';
+
+	u->strdata = storage + slack;
+	u->dataroom = 2 * needed;
+	u->dataslack = slack;
+}
+
 /* Update an undo item with (among other things) the file size and
  * cursor position after the given action. */
 void update_undo(undo_type action)
 {
 	undostruct *u = openfile->undotop;
-	size_t datalen, newlen;
+	size_t addition;
 	char *textposition;
 	int charlen;
 
@@ -1155,10 +1477,12 @@ void update_undo(undo_type action)
 
 	switch (u->type) {
 	case ADD:
-		newlen = openfile->current_x - u->head_x;
-		u->strdata = nrealloc(u->strdata, newlen + 1);
-		strncpy(u->strdata, openfile->current->data + u->head_x, newlen);
-		u->strdata[newlen] = '\0';
+		/* The typing is contiguous, so only the new bytes need to be added. */
+		addition = openfile->current_x - u->tail_x;
+		make_room_for(u, addition, FALSE);
+		memcpy(u->strdata + u->datalength, openfile->current->data + u->tail_x, addition);
+		u->datalength += addition;
+		u->strdata[u->datalength] = '\0';
 		u->tail_x = openfile->current_x;
 		break;
 	case ENTER:
@@ -1169,18 +1493,20 @@ void update_undo(undo_type action)
 	case DEL:
 		textposition = openfile->current->data + openfile->current_x;
 		charlen = char_length(textposition);
-		datalen = strlen(u->strdata);
 		if (openfile->current_x == u->head_x) {
 			/* They deleted more: add removed character after earlier stuff. */
-			u->strdata = nrealloc(u->strdata, datalen + charlen + 1);
-			strncpy(u->strdata + datalen, textposition, charlen);
-			u->strdata[datalen + charlen] = '\0';
+			make_room_for(u, charlen, FALSE);
+			memcpy(u->strdata + u->datalength, textposition, charlen);
+			u->datalength += charlen;
+			u->strdata[u->datalength] = '\0';
 			u->tail_x = openfile->current_x;
 		} else if (openfile->current_x == u->head_x - charlen) {
 			/* They backspaced further: add removed character before earlier. */
-			u->strdata = nrealloc(u->strdata, datalen + charlen + 1);
-			memmove(u->strdata + charlen, u->strdata, datalen + 1);
-			strncpy(u->strdata, textposition, charlen);
+			make_room_for(u, charlen, TRUE);
+			u->strdata -= charlen;
+			u->dataslack -= charlen;
+			memcpy(u->strdata, textposition, charlen);
+			u->datalength += charlen;
 			u->head_x = openfile->current_x;
 		} else
 			/* They deleted *elsewhere* on the line: start a new undo item. */
@@ -1225,7 +1551,7 @@ void update_undo(undo_type action)
 	case COUPLE_END:
 	case PASTE:
 	case INSERT:
-		u->tail_lineno = openfile->current->lineno;
+		u->tail_lineno = lineno_of(openfile->current);
 		u->tail_x = openfile->current_x;
 		break;
 	default:
@@ -1307,6 +1633,7 @@ bool do_wrap(void)
 			line->data = nrealloc(line->data, line_len + 2);
 			line->data[line_len] = ' ';
 			line->data[line_len + 1] = '\0';
+			forget_the_counts_of(line);
 			rest_length++;
 			openfile->totsize++;
 			openfile->current_x++;
@@ -1358,6 +1685,7 @@ bool do_wrap(void)
 
 		memmove(line->data + lead_len, line->data, line_len + 1);
 		strncpy(line->data, line->prev->data, lead_len);
+		forget_the_counts_of(line);
 
 		openfile->current_x += lead_len;
 #ifndef NANO_TINY
@@ -1558,7 +1886,7 @@ bool find_paragraph(linestruct **firstline, size_t *const linecount)
 		return FALSE;
 
 	/* We found a paragraph; determine its number of lines. */
-	*linecount = line->lineno - (*firstline)->lineno + 1;
+	*linecount = lineno_of(line) - lineno_of(*firstline) + 1;
 
 	return TRUE;
 }
@@ -1614,8 +1942,13 @@ void copy_character(char **from, char **to)
  * number of characters untreated. */
 void squeeze(linestruct *line, size_t skip)
 {
-	char *start = line->data + skip;
-	char *from = start, *to = start;
+	char *start, *from, *to;
+
+	make_text_private(line);
+
+	start = line->data + skip;
+	from = start;
+	to = start;
 
 	/* For each character, 1) when a blank, change it to a space, and pass over
 	 * all blanks after it; 2) if it is punctuation, copy it plus a possible
@@ -1844,7 +2177,7 @@ void do_justify(bool full_justify)
 		openfile->current = endline;
 		openfile->current_x = end_x;
 
-		linecount = endline->lineno - startline->lineno + (end_x > 0 ? 1 : 0);
+		linecount = lineno_of(endline) - lineno_of(startline) + (end_x > 0 ? 1 : 0);
 
 		/* Remember whether the end of the region was before the end-of-line. */
 		before_eol = endline->data[end_x] != '\0';
@@ -1907,8 +2240,10 @@ void do_justify(bool full_justify)
 		size_t text_len = strlen(line->data) - fore_len;
 
 		/* If the extracted region begins with any leading part, trim it. */
-		if (fore_len > 0)
+		if (fore_len > 0) {
+			make_text_private(line);
 			memmove(line->data, line->data + fore_len, text_len + 1);
+		}
 
 		/* Then copy back in the leading part that it should have. */
 		if (primary_len > 0) {
@@ -1960,6 +2295,10 @@ void do_justify(bool full_justify)
 		}
 	}
 
+	/* The justified lines have a different text now. */
+	for (jusline = cutbuffer; jusline != NULL; jusline = jusline->next)
+		forget_the_counts_of(jusline);
+
 #ifndef NANO_TINY
 	add_undo(PASTE, NULL);
 	if (full_justify && !openfile->mark && !cutbuffer->has_anchor)
@@ -2080,7 +2419,7 @@ bool replace_buffer(const char *filename, undo_type action, const char *operatio
 /* Execute the given program, with the given temp file as last argument. */
 void treat(char *tempfile_name, char *theprogram, bool spelling)
 {
-	ssize_t lineno_save = openfile->current->lineno;
+	ssize_t lineno_save = lineno_of(openfile->current);
 	size_t current_x_save = openfile->current_x;
 	size_t pww_save = openfile->placewewant;
 	bool was_at_eol = (openfile->current->data[openfile->current_x] == '\0');
@@ -2158,7 +2497,7 @@ void treat(char *tempfile_name, char *theprogram, bool spelling)
 #ifndef NANO_TINY
 	/* Replace the marked text (or entire text) with the corrected text. */
 	if (spelling && openfile->mark) {
-		ssize_t was_mark_lineno = openfile->mark->lineno;
+		ssize_t was_mark_lineno = lineno_of(openfile->mark);
 		bool upright = mark_is_before_cursor();
 
 		replaced = replace_buffer(tempfile_name, CUT, "spelling correction");
@@ -2940,51 +3279,44 @@ void do_formatter(void)
  * multibyte characters instead of single-byte characters. */
 void do_wordlinechar_count(void)
 {
-	linestruct *was_current = openfile->current;
-	size_t was_x = openfile->current_x;
 	linestruct *topline, *botline;
 	size_t top_x, bot_x;
-	size_t words = 0, chars = 0;
+	size_t words, chars;
 	ssize_t lines = 0;
 
 	/* Set the start and end point of the area to measure: either the marked
-	 * region or the whole buffer.  Then compute the number of characters. */
-	if (openfile->mark) {
+	 * region or the whole buffer. */
+	if (openfile->mark)
 		get_region(&topline, &top_x, &botline, &bot_x);
-
-		if (topline != botline)
-			chars = number_of_characters_in(topline->next, botline) + 1;
-
-		chars += mbstrlen(topline->data + top_x) - mbstrlen(botline->data + bot_x);
-	} else {
+	else {
 		topline = openfile->filetop;
 		top_x = 0;
 		botline = openfile->filebot;
 		bot_x = strlen(botline->data);
-
-		chars = openfile->totsize;
 	}
 
 	/* Compute the number of lines. */
-	lines = botline->lineno - topline->lineno;
+	lines = lineno_of(botline) - lineno_of(topline);
 	lines += (bot_x == 0 || (topline == botline && top_x == bot_x)) ? 0 : 1;
 
-	openfile->current = topline;
-	openfile->current_x = top_x;
+	/* The characters are the ones before the end point minus the ones
+	 * before the start point, taken from the running totals. */
+	chars = total_before(botline, FALSE) + chars_in(botline) -
+								mbstrlen(botline->data + bot_x);
+	chars -= total_before(topline, FALSE) + chars_in(topline) -
+								mbstrlen(topline->data + top_x);
 
-	/* Keep stepping to the next word (considering punctuation as part of a
-	 * word, as "wc -w" does), until we reach the end of the relevant area,
-	 * incrementing the word count for each successful step. */
-	while (openfile->current->lineno < botline->lineno ||
-				(openfile->current == botline && openfile->current_x < bot_x)) {
-		if (do_next_word(FALSE, TRUE))
-			words++;
+	/* Count the words (considering punctuation as part of a word, as "wc -w"
+	 * does) in the partial lines at either end, and take the ones of the
+	 * whole lines in between from the running totals. */
+	if (topline == botline)
+		words = words_between(topline->data, top_x, bot_x);
+	else {
+		words = words_between(topline->data, top_x, strlen(topline->data));
+		words += total_before(botline, TRUE) - total_before(topline->next, TRUE);
+		words += words_between(botline->data, 0, bot_x);
 	}
 
-	/* Restore where we were. */
-	openfile->current = was_current;
-	openfile->current_x = was_x;
-
 	/* Report on the status bar the number of lines, words, and characters. */
 	statusline(INFO, _("%s%zd %s,  %zu %s,  %zu %s"),
 						openfile->mark ? _("In Selection:  ") : "",
@@ -3025,56 +3357,413 @@ void do_verbatim_input(void)
 }
 
 #ifdef ENABLE_WORDCOMPLETION
-/* Return a copy of the found completion candidate. */
-char *copy_completion(char *text)
+/* Return a hash of the given text of the given length. */
+size_t hash_of(const char *text, size_t length)
 {
-	char *word;
-	size_t length = 0, index = 0;
+	unsigned long long hash = length, chunk;
 
-	/* Find the end of the candidate word to get its length. */
-	while (is_word_char(&text[length], FALSE))
-		length = step_right(text, length);
+	/* Mix in eight bytes at a time, as lines can be long. */
+	for (; length >= 8; text += 8, length -= 8) {
+		memcpy(&chunk, text, 8);
+		hash = (hash ^ chunk) * 0x9E3779B97F4A7C15ULL;
+		hash ^= hash >> 29;
+	}
 
-	/* Now copy this candidate to a new string. */
-	word = nmalloc(length + 1);
-	while (index < length)
-		word[index++] = *(text++);
-	word[index] = '\0';
+	chunk = 0;
+	memcpy(&chunk, text, length);
+	hash = (hash ^ chunk) * 0x9E3779B97F4A7C15ULL;
 
-	return word;
+	return (size_t)(hash ^ (hash >> 32));
 }
 
-/* Look at the fragment the user has typed, then search the current buffer for
- * the first word that starts with this fragment, and tentatively complete the
- * fragment.  If the user types 'Complete' again, search and paste the next
- * possible completion. */
+/* Return the slot in the table of known words where the given word
+ * is, or where it would go. */
+wordstruct **slot_for_word(const char *text, size_t length)
+{
+	size_t place = hash_of(text, length) & (known_size - 1);
+
+	while (known_words[place] != NULL && (known_words[place]->length != length ||
+						strncmp(known_words[place]->text, text, length) != 0))
+		place = (place + 1) & (known_size - 1);
+
+	return &known_words[place];
+}
+
+/* Put the given word into the table of known words. */
+void place_the_word(wordstruct *word)
+{
+	*slot_for_word(word->text, word->length) = word;
+}
+
+/* Return the entry for the given word, adding one when it is not yet known. */
+wordstruct *entry_for_word(const char *text, size_t length)
+{
+	wordstruct **slot;
+
+	/* Keep the table at most half full, so that probing stays short. */
+	if (2 * (known_count + 1) > known_size) {
+		size_t newsize = (known_size == 0) ? 1024 : 2 * known_size;
+
+		free(known_words);
+		known_words = nmalloc(newsize * sizeof(wordstruct *));
+		known_size = newsize;
+
+		for (size_t place = 0; place < known_size; place++)
+			known_words[place] = NULL;
+		for (size_t index = 0; index < known_count; index++)
+			place_the_word(alphabet[index]);
+
+		alphabet = nrealloc(alphabet, known_size / 2 * sizeof(wordstruct *));
+	}
+
+	slot = slot_for_word(text, length);
+
+	if (*slot == NULL) {
+		*slot = nmalloc(sizeof(wordstruct));
+		(*slot)->text = measured_copy(text, length);
+		(*slot)->length = length;
+		(*slot)->count = 0;
+		(*slot)->stamp = 0;
+		alphabet[known_count++] = *slot;
+		vanished_count++;
+	}
+
+	return *slot;
+}
+
+/* Record the words that occur in the given line, giving each the given stamp. */
+void record_the_words(linewordsstruct *record, const linestruct *line,
+						size_t fingerprint, size_t stamp)
+{
+	static wordstruct **found = NULL;
+	static size_t room = 0;
+	const char *data = line->data;
+	size_t index = 0, count = 0;
+
+	while (data[index] != '\0') {
+		size_t start = index;
+		wordstruct *word;
+
+		if (!is_word_char(data + index, FALSE)) {
+			index = step_right(data, index);
+			continue;
+		}
+
+		while (is_word_char(data + index, FALSE))
+			index = step_right(data, index);
+
+		word = entry_for_word(data + start, index - start);
+
+		if (word->count++ == 0)
+			vanished_count--;
+		if (word->stamp < stamp)
+			word->stamp = stamp;
+
+		if (count == room) {
+			room = (room == 0) ? 64 : 2 * room;
+			found = nrealloc(found, room * sizeof(wordstruct *));
+		}
+		found[count++] = word;
+	}
+
+	record->line = line;
+	record->fingerprint = fingerprint;
+	record->count = count;
+	record->words = NULL;
+
+	if (count > 0) {
+		record->words = nmalloc(count * sizeof(wordstruct *));
+		memcpy(record->words, found, count * sizeof(wordstruct *));
+	}
+}
+
+/* Withdraw the words of the given recorded line from the counts. */
+void drop_the_words(linewordsstruct *record)
+{
+	for (size_t index = 0; index < record->count; index++)
+		if (--record->words[index]->count == 0)
+			vanished_count++;
+
+	free(record->words);
+}
+
+/* Return the preferred slot for the given line in a table of the given size. */
+size_t home_of(const linestruct *line, size_t size)
+{
+	size_t key = (size_t)((uintptr_t)line >> 4) * 2654435761U;
+
+	return (key ^ (key >> 16)) & (size - 1);
+}
+
+/* Bring the recorded words of the given buffer up to date: only the lines
+ * whose text changed since the previous time get their words gathered anew.
+ * The records are kept in the order of the lines, so as long as no lines
+ * were added or removed, they can be checked off one by one; after such
+ * a shift, the remaining old records are found through a hash table. */
+void index_the_words_of(openfilestruct *buffer)
+{
+	wordindexstruct *index = buffer->words;
+	linewordsstruct *fresh = NULL;
+	size_t *places = NULL, mapsize = 1, shifted = 0, count = 0, room = 0;
+	size_t stamp = attempts;
+
+	if (index == NULL) {
+		index = nmalloc(sizeof(wordindexstruct));
+		index->version = 0;
+		index->lines = NULL;
+		index->count = 0;
+		index->room = 0;
+		buffer->words = index;
+		/* Words from a newly seen buffer do not count as recently typed. */
+		stamp = 0;
+	} else if (index->version == buffer->version)
+		return;
+
+	for (const linestruct *line = buffer->filetop; line != NULL; line = line->next) {
+		size_t fingerprint = hash_of(line->data, strlen(line->data));
+		linewordsstruct *old = NULL, *record;
+
+		if (fresh == NULL) {
+			/* When beyond the old records, simply append a new one. */
+			if (count == index->count) {
+				if (count == index->room) {
+					index->room = (count < 1024) ? 1024 : 2 * count;
+					index->lines = nrealloc(index->lines,
+										index->room * sizeof(linewordsstruct));
+				}
+				record_the_words(&index->lines[count++], line, fingerprint, stamp);
+				index->count = count;
+				continue;
+			}
+
+			record = &index->lines[count];
+
+			if (record->line == line) {
+				if (record->fingerprint != fingerprint) {
+					drop_the_words(record);
+					record_the_words(record, line, fingerprint, stamp);
+				}
+				count++;
+				continue;
+			}
+
+			/* Lines were added or removed: from here on, build a new array,
+			 * and map the lines of the remaining old records to their place. */
+			shifted = count;
+			room = (buffer->totlines > count) ? buffer->totlines : count + 1;
+			fresh = nmalloc(room * sizeof(linewordsstruct));
+			memcpy(fresh, index->lines, count * sizeof(linewordsstruct));
+
+			while (mapsize < 2 * (index->count - shifted))
+				mapsize *= 2;
+
+			places = nmalloc(mapsize * sizeof(size_t));
+			for (size_t spot = 0; spot < mapsize; spot++)
+				places[spot] = 0;
+
+			for (size_t place = shifted; place < index->count; place++) {
+				size_t spot = home_of(index->lines[place].line, mapsize);
+
+				while (places[spot] != 0)
+					spot = (spot + 1) & (mapsize - 1);
+				places[spot] = place + 1;
+			}
+		}
+
+		if (count == room) {
+			room *= 2;
+			fresh = nrealloc(fresh, room * sizeof(linewordsstruct));
+		}
+
+		/* Look for what was recorded for the line before, if anything. */
+		for (size_t spot = home_of(line, mapsize); places[spot] != 0;
+										spot = (spot + 1) & (mapsize - 1))
+			if (index->lines[places[spot] - 1].line == line) {
+				old = &index->lines[places[spot] - 1];
+				break;
+			}
+
+		record = &fresh[count++];
+
+		/* When the text of the line is unchanged, carry its words over. */
+		if (old != NULL && old->fingerprint == fingerprint) {
+			*record = *old;
+			old->words = NULL;
+			old->count = 0;
+			continue;
+		}
+
+		record_the_words(record, line, fingerprint, stamp);
+
+		if (old != NULL) {
+			drop_the_words(old);
+			old->words = NULL;
+			old->count = 0;
+		}
+	}
+
+	/* Whatever old records were not carried over belong to lines that are gone. */
+	for (size_t place = (fresh == NULL) ? count : shifted; place < index->count; place++)
+		drop_the_words(&index->lines[place]);
+
+	if (fresh != NULL) {
+		free(index->lines);
+		free(places);
+		index->lines = fresh;
+		index->room = room;
+	}
+
+	index->count = count;
+	index->version = buffer->version;
+}
+
+/* Withdraw the recorded words of the given buffer, as it is being closed. */
+void forget_the_words(openfilestruct *buffer)
+{
+	if (buffer->words == NULL)
+		return;
+
+	for (size_t place = 0; place < buffer->words->count; place++)
+		drop_the_words(&buffer->words->lines[place]);
+
+	free(buffer->words->lines);
+	free(buffer->words);
+	buffer->words = NULL;
+}
+
+/* Compare the texts of two words, for sorting them. */
+int alphabetically(const void *one, const void *two)
+{
+	return strcmp((*(const wordstruct **)one)->text, (*(const wordstruct **)two)->text);
+}
+
+/* Compare two candidates: recently seen ones first, then frequent ones. */
+int by_rank(const void *one, const void *two)
+{
+	const wordstruct *first = *(const wordstruct **)one;
+	const wordstruct *second = *(const wordstruct **)two;
+
+	if (first->stamp != second->stamp)
+		return (first->stamp > second->stamp) ? -1 : 1;
+	if (first->count != second->count)
+		return (first->count > second->count) ? -1 : 1;
+
+	return strcmp(first->text, second->text);
+}
+
+/* Bring the alphabet into order: discard the words that no longer occur
+ * when they have become many, and merge any new words into the sorted ones. */
+void tidy_the_alphabet(void)
+{
+	wordstruct **merged;
+	size_t one = 0, two, count = 0;
+
+	if (vanished_count > 1024 && 2 * vanished_count > known_count) {
+		for (size_t index = 0; index < known_count; index++) {
+			if (alphabet[index]->count > 0) {
+				if (index < sorted_count)
+					one++;
+				alphabet[count++] = alphabet[index];
+			} else {
+				free(alphabet[index]->text);
+				free(alphabet[index]);
+			}
+		}
+
+		for (size_t place = 0; place < known_size; place++)
+			known_words[place] = NULL;
+		for (size_t index = 0; index < count; index++)
+			place_the_word(alphabet[index]);
+
+		known_count = count;
+		sorted_count = one;
+		vanished_count = 0;
+	}
+
+	if (sorted_count == known_count)
+		return;
+
+	qsort(alphabet + sorted_count, known_count - sorted_count,
+						sizeof(wordstruct *), alphabetically);
+
+	merged = nmalloc(known_count * sizeof(wordstruct *));
+	one = 0;
+	two = sorted_count;
+	count = 0;
+
+	while (one < sorted_count && two < known_count)
+		merged[count++] = (alphabetically(&alphabet[one], &alphabet[two]) < 0) ?
+								alphabet[one++] : alphabet[two++];
+	while (one < sorted_count)
+		merged[count++] = alphabet[one++];
+	while (two < known_count)
+		merged[count++] = alphabet[two++];
+
+	memcpy(alphabet, merged, known_count * sizeof(wordstruct *));
+	free(merged);
+
+	sorted_count = known_count;
+}
+
+/* Collect the words that begin with the given shard and are longer than it,
+ * skipping the word under the cursor when it occurs nowhere else, and put
+ * them in order of preference. */
+void gather_candidates(const char *shard, size_t shard_length, const wordstruct *own)
+{
+	size_t low = 0, high = sorted_count;
+
+	/* Find the first word that does not sort before the shard. */
+	while (low < high) {
+		size_t middle = low + (high - low) / 2;
+
+		if (strcmp(alphabet[middle]->text, shard) < 0)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+
+	candidate_count = 0;
+
+	for (high = low; high < sorted_count &&
+					strncmp(alphabet[high]->text, shard, shard_length) == 0; high++) {
+		const wordstruct *word = alphabet[high];
+
+		if (word->length > shard_length && word->count > (word == own ? 1 : 0))
+			candidate_count++;
+	}
+
+	free(candidates);
+	candidates = nmalloc((candidate_count + 1) * sizeof(wordstruct *));
+	candidate_count = 0;
+
+	for (; low < high; low++) {
+		wordstruct *word = alphabet[low];
+
+		if (word->length > shard_length && word->count > (word == own ? 1 : 0))
+			candidates[candidate_count++] = word;
+	}
+
+	qsort(candidates, candidate_count, sizeof(wordstruct *), by_rank);
+}
+
+/* Look at the fragment the user has typed, then look among the words in all
+ * open buffers for the ones that start with this fragment, and tentatively
+ * complete the fragment with the best one.  If the user types 'Complete'
+ * again, paste the next possible completion instead. */
 void complete_a_word(void)
 {
-	char *shard, *completion = NULL;
-	size_t start_of_shard, shard_length = 0;
-	size_t i = 0, j = 0;
-	completion_word *some_word;
+	char *shard;
+	size_t start_of_shard, end_of_word, shard_length = 0;
+	wordstruct *completion;
 #ifdef ENABLE_WRAPPING
 	bool was_set_wrapping = ISSET(BREAK_LONG_LINES);
 #endif
 
 	/* If this is a fresh completion attempt... */
 	if (pletion_line == NULL) {
-		/* Clear the list of words of a previous completion run. */
-		while (list_of_completions != NULL) {
-			completion_word *dropit = list_of_completions;
-			list_of_completions = list_of_completions->next;
-			free(dropit->word);
-			free(dropit);
-		}
-
 		/* Prevent a completion from being merged with typed text. */
 		openfile->last_action = OTHER;
 
-		/* Initialize the starting point for searching. */
-		pletion_line = openfile->filetop;
-		pletion_x = 0;
-
 		/* Wipe the "No further matches" message. */
 		wipe_statusbar();
 	} else {
@@ -3100,99 +3789,71 @@ void complete_a_word(void)
 		return;
 	}
 
-	shard = nmalloc(openfile->current_x - start_of_shard + 1);
+	shard = measured_copy(openfile->current->data + start_of_shard,
+								openfile->current_x - start_of_shard);
+	shard_length = openfile->current_x - start_of_shard;
 
-	/* Copy the fragment that has to be searched for. */
-	while (start_of_shard < openfile->current_x)
-		shard[shard_length++] = openfile->current->data[start_of_shard++];
-	shard[shard_length] = '\0';
+	/* For a fresh attempt, update the word index and pick the candidates. */
+	if (pletion_line == NULL) {
+		const wordstruct *own = NULL;
+#ifdef ENABLE_MULTIBUFFER
+		openfilestruct *buffer = openfile;
 
-	/* Run through all of the lines in the buffer, looking for shard. */
-	while (pletion_line != NULL) {
-		ssize_t threshold = strlen(pletion_line->data) - shard_length - 1;
-				/* The point where we can stop searching for shard. */
+		do {
+			index_the_words_of(buffer);
+			buffer = buffer->next;
+		} while (buffer != openfile);
+#else
+		index_the_words_of(openfile);
+#endif
+		attempts++;
+		tidy_the_alphabet();
 
-		/* Traverse the whole line, looking for shard. */
-		for (i = pletion_x; (ssize_t)i < threshold; i++) {
-			/* If the first byte doesn't match, run on. */
-			if (pletion_line->data[i] != shard[0])
-				continue;
+		/* Find the end of the word that the cursor is in, if any. */
+		end_of_word = openfile->current_x;
+		while (is_word_char(&openfile->current->data[end_of_word], FALSE))
+			end_of_word = step_right(openfile->current->data, end_of_word);
 
-			/* Compare the rest of the bytes in shard. */
-			for (j = 1; j < shard_length; j++)
-				if (pletion_line->data[i + j] != shard[j])
-					break;
+		if (end_of_word > openfile->current_x && known_size > 0)
+			own = *slot_for_word(openfile->current->data + start_of_shard,
+										end_of_word - start_of_shard);
 
-			/* If not all of the bytes matched, continue searching. */
-			if (j < shard_length)
-				continue;
+		gather_candidates(shard, shard_length, own);
 
-			/* If the found match is not /longer/ than shard, skip it. */
-			if (!is_word_char(&pletion_line->data[i + j], FALSE))
-				continue;
-
-			/* If the match is not a separate word, skip it. */
-			if (i > 0 && is_word_char(&pletion_line->data[
-								step_left(pletion_line->data, i)], FALSE))
-				continue;
-
-			/* If this match is the shard itself, ignore it. */
-			if (pletion_line == openfile->current &&
-								i == openfile->current_x - shard_length)
-				continue;
+		pletion_line = openfile->current;
+		pletion_x = 0;
+	}
 
-			completion = copy_completion(pletion_line->data + i);
+	free(shard);
 
-			/* Look among earlier attempted completions for a duplicate. */
-			some_word = list_of_completions;
-			while (some_word && strcmp(some_word->word, completion) != 0)
-				some_word = some_word->next;
+	/* When all candidates have been tried, say so. */
+	if (pletion_x == candidate_count) {
+		if (candidate_count > 0) {
+			statusline(AHEM, _("No further matches"));
+			refresh_needed = TRUE;
+		} else
+			/* TRANSLATORS: Shown when there are zero possible completions. */
+			statusline(AHEM, _("No matches"));
 
-			/* If we've already tried this word, skip it. */
-			if (some_word != NULL) {
-				free(completion);
-				continue;
-			}
+		pletion_line = NULL;
+		return;
+	}
 
-			/* Add the found word to the list of completions. */
-			some_word = nmalloc(sizeof(completion_word));
-			some_word->word = completion;
-			some_word->next = list_of_completions;
-			list_of_completions = some_word;
+	completion = candidates[pletion_x++];
 
 #ifdef ENABLE_WRAPPING
-			/* Temporarily disable wrapping so only one undo item is added. */
-			UNSET(BREAK_LONG_LINES);
+	/* Temporarily disable wrapping so only one undo item is added. */
+	UNSET(BREAK_LONG_LINES);
 #endif
-			/* Inject the completion into the buffer. */
-			inject(&completion[shard_length], strlen(completion) - shard_length);
+	/* Inject the completion into the buffer. */
+	inject(completion->text + shard_length, completion->length - shard_length);
 
 #ifdef ENABLE_WRAPPING
-			/* If needed, reenable wrapping and wrap the current line. */
-			if (was_set_wrapping) {
-				SET(BREAK_LONG_LINES);
-				do_wrap();
-			}
-#endif
-			/* Set the position for a possible next search attempt. */
-			pletion_x = ++i;
-
-			free(shard);
-			return;
-		}
-
-		pletion_line = pletion_line->next;
-		pletion_x = 0;
+	/* If needed, reenable wrapping and wrap the current line. */
+	if (was_set_wrapping) {
+		SET(BREAK_LONG_LINES);
+		do_wrap();
 	}
-
-	/* The search has reached the end of the file. */
-	if (list_of_completions != NULL) {
-		statusline(AHEM, _("No further matches"));
-		refresh_needed = TRUE;
-	} else
-		/* TRANSLATORS: Shown when there are zero possible completions. */
-		statusline(AHEM, _("No matches"));
-
-	free(shard);
+#endif
 }
 #endif /* ENABLE_WORDCOMPLETION */
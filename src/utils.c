@@ -160,12 +160,10 @@ bool parse_line_column(const char *str, ssize_t *line, ssize_t *column)
 /* In the given string, recode each embedded NUL as a newline. */
 void recode_NUL_to_LF(char *string, size_t length)
 {
-	while (length > 0) {
-		if (*string == '\0')
-			*string = '\n';
-		length--;
-		string++;
-	}
+	char *end = string + length;
+
+	while ((string = memchr(string, '\0', end - string)) != NULL)
+		*(string++) = '\n';
 }
 
 /* In the given string, recode each embedded newline as a NUL. */
@@ -208,6 +206,19 @@ bool is_separate_word(size_t position, size_t length, const char *text)
 }
 #endif /* ENABLE_SPELLER */
 
+static char *starts_text = NULL;
+		/* The line of which the regex match starts below were collected. */
+static char *starts_regex = NULL;
+		/* The regex with which those match starts were found. */
+static bool starts_casing = FALSE;
+		/* Whether that regex was compiled case-sensitively. */
+static size_t *match_starts = NULL;
+		/* The positions in that line where a match starts, in order. */
+static size_t starts_count = 0, starts_room = 0;
+		/* The number of collected match starts, and the room for them. */
+static size_t starts_reach = 0;
+		/* The position from where to continue collecting match starts. */
+
 /* Return the position of the needle in the haystack, or NULL if not found.
  * When searching backwards, we will find the last match that starts no later
  * than the given start; otherwise, we find the first match starting no earlier
@@ -218,41 +229,59 @@ const char *strstrwrapper(const char *haystack, const char *needle,
 {
 	if (ISSET(USE_REGEXP)) {
 		if (ISSET(BACKWARDS_SEARCH)) {
-			size_t last_find, ceiling, far_end;
-			size_t floor = 0, next_rung = 0;
-				/* The start of the search range, and the next start. */
+			size_t ceiling = start - haystack;
+			size_t far_end = strlen(haystack);
+			size_t lower = 0, upper;
+
+			/* When the line or the regex differs from last time, start afresh. */
+			if (starts_text == NULL || strcmp(starts_text, haystack) != 0 ||
+						strcmp(starts_regex, needle) != 0 ||
+						starts_casing != ISSET(CASE_SENSITIVE)) {
+				starts_text = mallocstrcpy(starts_text, haystack);
+				starts_regex = mallocstrcpy(starts_regex, needle);
+				starts_casing = ISSET(CASE_SENSITIVE);
+				starts_count = 0;
+				starts_reach = 0;
+			}
 
-			if (regexec(&search_regexp, haystack, 1, regmatches, 0) != 0)
-				return NULL;
+			/* Collect in one forward pass the positions where matches start,
+			 * until beyond the search range, continuing where an earlier
+			 * search on this same line (and with this same regex) stopped. */
+			while (starts_reach <= ceiling && starts_reach <= far_end) {
+				regmatches[0].rm_so = starts_reach;
+				regmatches[0].rm_eo = far_end;
+				if (regexec(search_regexp, haystack, 1, regmatches, REG_STARTEND) != 0) {
+					starts_reach = far_end + 1;
+					break;
+				}
 
-			far_end = strlen(haystack);
-			ceiling = start - haystack;
-			last_find = regmatches[0].rm_so;
+				if (starts_count == starts_room) {
+					starts_room = 2 * starts_room + 16;
+					match_starts = nrealloc(match_starts, starts_room * sizeof(size_t));
+				}
 
-			/* A result beyond the search range also means: no match. */
-			if (last_find > ceiling)
-				return NULL;
+				match_starts[starts_count++] = regmatches[0].rm_so;
+				starts_reach = step_right(haystack, regmatches[0].rm_so);
+			}
 
-			/* Move the start-of-range forward until there is no more match;
-			 * then the last match found is the first match backwards. */
-			while (regmatches[0].rm_so <= ceiling) {
-				floor = next_rung;
-				last_find = regmatches[0].rm_so;
-				/* If this is the last possible match, don't try to advance. */
-				if (last_find == ceiling)
-					break;
-				next_rung = step_right(haystack, last_find);
-				regmatches[0].rm_so = next_rung;
-				regmatches[0].rm_eo = far_end;
-				if (regexec(&search_regexp, haystack, 1, regmatches,
-										REG_STARTEND) != 0)
-					break;
+			/* Find the last match start that lies within the search range. */
+			upper = starts_count;
+			while (lower < upper) {
+				size_t middle = (lower + upper) / 2;
+
+				if (match_starts[middle] <= ceiling)
+					lower = middle + 1;
+				else
+					upper = middle;
 			}
 
-			/* Find the last match again, to get possible submatches. */
-			regmatches[0].rm_so = floor;
+			if (lower == 0)
+				return NULL;
+
+			/* Match again at that position, to get possible submatches. */
+			regmatches[0].rm_so = match_starts[lower - 1];
 			regmatches[0].rm_eo = far_end;
-			if (regexec(&search_regexp, haystack, 10, regmatches,
+			if (regexec(search_regexp, haystack, 10, regmatches,
 										REG_STARTEND) != 0)
 				return NULL;
 
@@ -262,7 +291,7 @@ const char *strstrwrapper(const char *haystack, const char *needle,
 		/* Do a forward regex search from the starting point. */
 		regmatches[0].rm_so = start - haystack;
 		regmatches[0].rm_eo = strlen(haystack);
-		if (regexec(&search_regexp, haystack, 10, regmatches,
+		if (regexec(search_regexp, haystack, 10, regmatches,
 										REG_STARTEND) != 0)
 			return NULL;
 		else
@@ -297,11 +326,212 @@ void *nmalloc(size_t howmuch)
 	return r;
 }
 
+/* The number of line nodes that get allocated in one go. */
+#define NODES_PER_SLAB  4096
+
+/* The size of each chunk of the arena that holds the text of read lines. */
+#define ARENA_CHUNK_SIZE  (4 * 1024 * 1024)
+
+/* Lines longer than this get a chunk of their own instead of sharing one. */
+#define ARENA_LINE_LIMIT  (ARENA_CHUNK_SIZE / 16)
+
+static linestruct *spare_nodes = NULL;
+		/* The line nodes that are free for use, linked through their next. */
+static arenachunk **chunks = NULL;
+		/* The chunks of the line-text arena, sorted by address. */
+static size_t chunk_count = 0;
+		/* The number of chunks in the above array. */
+static arenachunk *current_chunk = NULL;
+		/* The chunk from which new line text is handed out. */
+
+/* Return an uninitialized node for a line.  The nodes are carved out of
+ * big slabs, to avoid paying the overhead of a malloc() for each line. */
+linestruct *allocate_node(void)
+{
+	linestruct *node;
+
+	if (spare_nodes == NULL) {
+		linestruct *slab = nmalloc(NODES_PER_SLAB * sizeof(linestruct));
+
+		for (int index = NODES_PER_SLAB - 1; index >= 0; index--) {
+			slab[index].next = spare_nodes;
+			spare_nodes = &slab[index];
+		}
+	}
+
+	node = spare_nodes;
+	spare_nodes = node->next;
+
+	return node;
+}
+
+/* Put the given node back among the spare ones. */
+void release_node(linestruct *node)
+{
+	node->next = spare_nodes;
+	spare_nodes = node;
+}
+
+/* Return the arena chunk that contains the given text, or NULL when
+ * the text was allocated on its own. */
+arenachunk *chunk_holding(const void *text)
+{
+	size_t lower = 0, upper = chunk_count;
+
+	while (lower < upper) {
+		size_t middle = (lower + upper) / 2;
+
+		if ((const char *)text < chunks[middle]->start)
+			upper = middle;
+		else if ((const char *)text >= chunks[middle]->end)
+			lower = middle + 1;
+		else
+			return chunks[middle];
+	}
+
+	return NULL;
+}
+
+/* Note that one line less has its text in the given chunk, and give
+ * the chunk back to the system when no line is using it any more. */
+void let_go_of(arenachunk *chunk)
+{
+	if (--chunk->users > 0)
+		return;
+
+	/* The chunk being filled is simply reused from its beginning. */
+	if (chunk == current_chunk)
+		chunk->filled = chunk->start;
+	else
+		discard_chunk(chunk);
+}
+
+/* Remove the given chunk from the arena and free its memory. */
+void discard_chunk(arenachunk *chunk)
+{
+	size_t index = 0;
+
+	while (chunks[index] != chunk)
+		index++;
+
+	memmove(chunks + index, chunks + index + 1,
+						(chunk_count - index - 1) * sizeof(arenachunk *));
+	chunk_count--;
+
+	free(chunk->start);
+	free(chunk);
+}
+
+/* Add a chunk of the given size to the arena, and return it. */
+arenachunk *add_chunk(size_t size)
+{
+	arenachunk *chunk = nmalloc(sizeof(arenachunk));
+	size_t index = chunk_count;
+
+	chunk->start = nmalloc(size);
+	chunk->end = chunk->start + size;
+	chunk->filled = chunk->start;
+	chunk->users = 0;
+
+	/* Keep the chunks sorted, for a binary search in chunk_holding(). */
+	chunks = nrealloc(chunks, (chunk_count + 1) * sizeof(arenachunk *));
+	while (index > 0 && chunks[index - 1]->start > chunk->start) {
+		chunks[index] = chunks[index - 1];
+		index--;
+	}
+	chunks[index] = chunk;
+	chunk_count++;
+
+	return chunk;
+}
+
+/* Return a copy of the first count bytes of the given text, NUL-terminated,
+ * stored in the arena.  Text in the arena is never changed: it can be shared
+ * by several lines (see share_data()), and it gets moved out of the arena
+ * (by nrealloc() or make_text_private()) the first time that it has to
+ * be altered.  It must be freed with free_data(). */
+char *arena_copy(const char *text, size_t count)
+{
+	arenachunk *chunk;
+	char *thecopy;
+
+	/* A long line gets a chunk of its own, so that it can be shared too. */
+	if (count >= ARENA_LINE_LIMIT)
+		chunk = add_chunk(count + 1);
+	else {
+		if (current_chunk == NULL || current_chunk->filled + count + 1 > current_chunk->end) {
+			/* When the old chunk isn't used by any line, get rid of it. */
+			if (current_chunk != NULL && current_chunk->users == 0)
+				discard_chunk(current_chunk);
+
+			current_chunk = add_chunk(ARENA_CHUNK_SIZE);
+		}
+		chunk = current_chunk;
+	}
+
+	thecopy = chunk->filled;
+	chunk->filled += count + 1;
+	chunk->users++;
+
+	memcpy(thecopy, text, count);
+	thecopy[count] = '\0';
+
+	return thecopy;
+}
+
+/* Return the given text of a line in a form that another line can use too:
+ * when the text lives in the arena, just count one more user of it, and
+ * otherwise copy it into the arena (where further copies can share it). */
+char *share_data(char *text)
+{
+	arenachunk *chunk = chunk_holding(text);
+
+	if (chunk == NULL)
+		return arena_copy(text, strlen(text));
+
+	chunk->users++;
+
+	return text;
+}
+
+/* Make sure that the text of the given line is not shared with any other
+ * line, so that it can be changed in place. */
+void make_text_private(linestruct *line)
+{
+	if (chunk_holding(line->data) != NULL)
+		line->data = nrealloc(line->data, strlen(line->data) + 1);
+}
+
+/* Free the given text of a line, whether it lives in the arena or not. */
+void free_data(char *text)
+{
+	arenachunk *chunk = (text == NULL) ? NULL : chunk_holding(text);
+
+	if (chunk == NULL)
+		free(text);
+	else
+		let_go_of(chunk);
+}
+
 /* This is a wrapper for the realloc() function that properly handles
- * things when we run out of memory. */
+ * things when we run out of memory.  Line text that lives in the arena
+ * is copied out of it into its own allocation. */
 void *nrealloc(void *ptr, size_t howmuch)
 {
-	void *r = realloc(ptr, howmuch);
+	arenachunk *chunk = (ptr == NULL) ? NULL : chunk_holding(ptr);
+	void *r;
+
+	if (chunk != NULL) {
+		size_t length = strlen(ptr) + 1;
+
+		r = nmalloc(howmuch);
+		memcpy(r, ptr, (length < howmuch) ? length : howmuch);
+		let_go_of(chunk);
+
+		return r;
+	}
+
+	r = realloc(ptr, howmuch);
 
 	if (howmuch == 0)
 		die("Allocating zero bytes.  Please report a bug.\n");
@@ -349,6 +579,129 @@ char *free_and_assign(char *dest, char *src)
 	return src;
 }
 
+#ifndef NANO_TINY
+/* The distance (in bytes) between the checkpoints of a long line. */
+#define CHECKPOINT_STRIDE  1024
+
+/* Lines at least this long get a table of checkpoints when measured. */
+#define LONG_LINE  (16 * CHECKPOINT_STRIDE)
+
+/* The number of long lines that can have a table of checkpoints at once. */
+#define POINTED_LINES  8
+
+static linestruct *pointed_lines[POINTED_LINES];
+		/* The long lines that have a table of checkpoints. */
+static size_t *checkpoints[POINTED_LINES];
+		/* For each of those lines, pairs of a byte index and its column. */
+static size_t checkpoint_count[POINTED_LINES];
+		/* The number of pairs in each of those tables. */
+static ssize_t checkpoint_tabsize[POINTED_LINES];
+		/* The tab size with which the columns in each table were computed. */
+static int pointed_count = 0;
+		/* The number of lines that currently have a table. */
+static int next_slot = 0;
+		/* The slot that gets reused next when all of them are taken. */
+
+/* Drop the table of checkpoints of the given line, if it has one. */
+void forget_the_checkpoints_of(const linestruct *line)
+{
+	for (int slot = 0; slot < pointed_count; slot++) {
+		if (pointed_lines[slot] != line)
+			continue;
+
+		free(checkpoints[slot]);
+
+		pointed_count--;
+		pointed_lines[slot] = pointed_lines[pointed_count];
+		checkpoints[slot] = checkpoints[pointed_count];
+		checkpoint_count[slot] = checkpoint_count[pointed_count];
+		checkpoint_tabsize[slot] = checkpoint_tabsize[pointed_count];
+		return;
+	}
+}
+
+/* When the given line is long, give it a table with the byte index and the
+ * column of a character at about every CHECKPOINT_STRIDE bytes, so that the
+ * conversions between index and column need not walk the whole line. */
+void plant_checkpoints_in(linestruct *line)
+{
+	const char *text = line->data;
+	size_t index = 0, column = 0, count = 0;
+	size_t next = CHECKPOINT_STRIDE;
+	size_t *table;
+	int slot;
+
+	for (slot = 0; slot < pointed_count; slot++)
+		if (pointed_lines[slot] == line && checkpoint_tabsize[slot] == tabsize)
+			return;
+
+	forget_the_checkpoints_of(line);
+
+	if (strnlen(text, LONG_LINE) < LONG_LINE)
+		return;
+
+	table = nmalloc((strlen(text) / CHECKPOINT_STRIDE + 1) * 2 * sizeof(size_t));
+
+	while (text[index] != '\0') {
+		if (index >= next) {
+			table[count * 2] = index;
+			table[count * 2 + 1] = column;
+			next = index + CHECKPOINT_STRIDE;
+			count++;
+		}
+
+		index += advance_over(text + index, &column);
+	}
+
+	/* When all slots are taken, reuse them in turn. */
+	if (pointed_count == POINTED_LINES) {
+		slot = next_slot;
+		next_slot = (next_slot + 1) % POINTED_LINES;
+		free(checkpoints[slot]);
+	} else
+		slot = pointed_count++;
+
+	pointed_lines[slot] = line;
+	checkpoints[slot] = table;
+	checkpoint_count[slot] = count;
+	checkpoint_tabsize[slot] = tabsize;
+}
+
+/* When the given text is that of a line with a table of checkpoints, find
+ * the last checkpoint that lies before the given limit -- a byte index, or
+ * a column when by_column is TRUE -- and return TRUE when there is one. */
+bool nearest_checkpoint(const char *text, size_t limit, bool by_column,
+						size_t *index, size_t *column)
+{
+	for (int slot = 0; slot < pointed_count; slot++) {
+		const size_t *table = checkpoints[slot];
+		size_t lower = 0, upper = checkpoint_count[slot];
+
+		if (pointed_lines[slot]->data != text || checkpoint_tabsize[slot] != tabsize)
+			continue;
+
+		/* Find the first checkpoint that does not lie before the limit. */
+		while (lower < upper) {
+			size_t middle = (lower + upper) / 2;
+
+			if (table[middle * 2 + by_column] < limit)
+				lower = middle + 1;
+			else
+				upper = middle;
+		}
+
+		if (lower == 0)
+			return FALSE;
+
+		*index = table[(lower - 1) * 2];
+		*column = table[(lower - 1) * 2 + 1];
+		return TRUE;
+	}
+
+	return FALSE;
+}
+#endif /* !NANO_TINY */
+
 /* When not softwrapping, nano scrolls the current line horizontally by
  * chunks ("pages").  Return the column number of the first character
  * displayed in the edit window when the cursor is at the given column. */
@@ -366,6 +719,9 @@ size_t get_page_start(size_t column)
  * column position of the cursor. */
 size_t xplustabs(void)
 {
+#ifndef NANO_TINY
+	plant_checkpoints_in(openfile->current);
+#endif
 	return wideness(openfile->current->data, openfile->current_x);
 }
 
@@ -377,6 +733,13 @@ size_t actual_x(const char *text, size_t column)
 		/* From where we start walking through the text. */
 	size_t width = 0;
 		/* The current accumulated span, in columns. */
+#ifndef NANO_TINY
+	size_t index;
+
+	/* On a long line, start walking from the nearest checkpoint. */
+	if (nearest_checkpoint(text, column, TRUE, &index, &width))
+		text += index;
+#endif
 
 	while (*text != '\0') {
 		int charlen = advance_over(text, &width);
@@ -395,10 +758,21 @@ size_t actual_x(const char *text, size_t column)
 size_t wideness(const char *text, size_t maxlen)
 {
 	size_t width = 0;
+#ifndef NANO_TINY
+	size_t index;
+#endif
 
 	if (maxlen == 0)
 		return 0;
 
+#ifndef NANO_TINY
+	/* On a long line, start walking from the nearest checkpoint. */
+	if (nearest_checkpoint(text, maxlen, FALSE, &index, &width)) {
+		text += index;
+		maxlen -= index;
+	}
+#endif
+
 	while (*text != '\0') {
 		size_t charlen = advance_over(text, &width);
 
@@ -416,6 +790,13 @@ size_t wideness(const char *text, size_t maxlen)
 size_t breadth(const char *text)
 {
 	size_t span = 0;
+#ifndef NANO_TINY
+	size_t index;
+
+	/* On a long line, start walking from the last checkpoint. */
+	if (nearest_checkpoint(text, (size_t)-1, FALSE, &index, &span))
+		text += index;
+#endif
 
 	while (*text != '\0')
 		text += advance_over(text, &span);
@@ -433,6 +814,7 @@ void new_magicline(void)
 	openfile->filebot->extrarows = 0;
 #endif
 	openfile->totsize++;
+	openfile->totlines++;
 }
 
 #if !defined(NANO_TINY) || defined(ENABLE_HELP)
@@ -442,11 +824,535 @@ void remove_magicline(void)
 {
 	if (openfile->filebot->data[0] == '\0' &&
 				openfile->filebot != openfile->filetop) {
+		forget_index_from(openfile->totlines);
+#ifndef NANO_TINY
+		discount_the_extra_rows(openfile->filebot, openfile->filebot);
+#endif
 		openfile->filebot = openfile->filebot->prev;
 		delete_node(openfile->filebot->next);
 		openfile->filebot->next = NULL;
 		openfile->totsize--;
+		openfile->totlines--;
+	}
+}
+#endif
+
+/* The distance (in lines) between the lines that are kept in the line index. */
+#define INDEX_STRIDE  32
+
+/* Drop the entries of the line index from the given line number onward,
+ * because the lines from there on have shifted or have gone away. */
+void forget_index_from(ssize_t number)
+{
+	size_t keep = (number < 2) ? 0 : (number + INDEX_STRIDE - 2) / INDEX_STRIDE;
+
+	if (keep < openfile->indexed)
+		openfile->indexed = keep;
+	if (keep < openfile->charsindexed)
+		openfile->charsindexed = keep;
+#ifndef NANO_TINY
+	if (keep < openfile->rowsindexed)
+		openfile->rowsindexed = keep;
+	if (keep < openfile->wordsindexed)
+		openfile->wordsindexed = keep;
+
+	/* The depths of a stretch are valid only when all its lines are. */
+	keep = (number < 2) ? 0 : (number - 1) / INDEX_STRIDE;
+
+	if (keep < openfile->depthsindexed)
+		openfile->depthsindexed = keep;
+#endif
+}
+
+/* Give the lines from the first one with a doubtful number onward their
+ * proper numbers, until the given line or the given number is reached. */
+void settle_numbers(const linestruct *target, ssize_t upto)
+{
+	ssize_t number = openfile->unnumbered;
+	linestruct *line = (number == 1) ? openfile->filetop :
+								line_from_number(number - 1)->next;
+
+	for (; line != NULL; line = line->next) {
+		line->lineno = number++;
+
+		if (line == target || line->lineno == upto) {
+			line = line->next;
+			break;
+		}
+	}
+
+	openfile->unnumbered = (line == NULL) ? 0 : number;
+}
+
+/* Return the number of the given line of the current buffer, first bringing
+ * the stored numbers up to date as far as this line when needed. */
+ssize_t lineno_of(const linestruct *line)
+{
+	if (openfile->unnumbered == 0)
+		return line->lineno;
+
+	if (line == openfile->filebot)
+		return openfile->totlines;
+
+	/* The stored numbers of the lines before the doubtful ones are right,
+	 * but a later line can have a stale number that is equally low. */
+	if (line->lineno < openfile->unnumbered && line_from_number(line->lineno) == line)
+		return line->lineno;
+
+	settle_numbers(line, 0);
+
+	return line->lineno;
+}
+
+/* Return a pointer to the line that has the given line number.  Entry k of
+ * the line index holds line k * INDEX_STRIDE + 1; the index gets extended
+ * as far as needed by walking onward from its last valid entry. */
+linestruct *line_from_number(ssize_t number)
+{
+	size_t wanted = (number < 2) ? 0 : (number - 1) / INDEX_STRIDE;
+	linestruct *line;
+
+	if (openfile->unnumbered > 0 && number >= openfile->unnumbered)
+		settle_numbers(NULL, number);
+
+	if (openfile->indexed <= wanted) {
+		if (openfile->indexsize <= wanted) {
+			openfile->indexsize = wanted + wanted / 2 + 64;
+			openfile->lineindex = nrealloc(openfile->lineindex,
+								openfile->indexsize * sizeof(linestruct *));
+			openfile->charsbefore = nrealloc(openfile->charsbefore,
+								openfile->indexsize * sizeof(size_t));
+#ifndef NANO_TINY
+			openfile->rowsbefore = nrealloc(openfile->rowsbefore,
+								openfile->indexsize * sizeof(size_t));
+			openfile->wordsbefore = nrealloc(openfile->wordsbefore,
+								openfile->indexsize * sizeof(size_t));
+#endif
+		}
+
+		if (openfile->indexed == 0)
+			openfile->lineindex[openfile->indexed++] = openfile->filetop;
+
+		line = openfile->lineindex[openfile->indexed - 1];
+
+		while (openfile->indexed <= wanted) {
+			for (int step = 0; step < INDEX_STRIDE; step++)
+				line = line->next;
+			openfile->lineindex[openfile->indexed++] = line;
+		}
 	}
+
+	line = openfile->lineindex[wanted];
+
+	while (line->lineno < number)
+		line = line->next;
+
+	return line;
+}
+
+/* Note that the text of the given line has changed: drop its cached counts
+ * and checkpoints, and the running totals of characters and words and the
+ * bracket depths from that line onward. */
+void forget_the_counts_of(linestruct *line)
+{
+	size_t keep = (line->lineno < 1) ? 0 : (line->lineno + INDEX_STRIDE - 1) / INDEX_STRIDE;
+
+	line->charcount = -1;
+	if (keep < openfile->charsindexed)
+		openfile->charsindexed = keep;
+#ifndef NANO_TINY
+	line->wordcount = -1;
+	if (keep < openfile->wordsindexed)
+		openfile->wordsindexed = keep;
+
+	keep = (line->lineno < 1) ? 0 : (line->lineno - 1) / INDEX_STRIDE;
+
+	line->lowestdepth = 1;
+	if (keep < openfile->depthsindexed)
+		openfile->depthsindexed = keep;
+
+	forget_the_checkpoints_of(line);
+#endif
+}
+
+/* Return the number of characters in the given line, counting them only
+ * when they were not counted since the line last changed. */
+size_t chars_in(linestruct *line)
+{
+	size_t count;
+
+	if (line->charcount >= 0)
+		return line->charcount;
+
+	count = mbstrlen(line->data);
+
+	/* A count that does not fit is simply not cached. */
+	if (count <= INT_MAX)
+		line->charcount = count;
+
+	return count;
+}
+
+#ifndef NANO_TINY
+/* Return the number of words (counting punctuation as part of a word, like
+ * "wc -w" does) that start in the given text from index start up to index
+ * end.  A word that is already underway at start is counted too. */
+size_t words_between(const char *text, size_t start, size_t end)
+{
+	bool seen_space = TRUE;
+	size_t count = 0;
+
+	while (start < end) {
+#ifdef ENABLE_UTF8
+		/* Zero-width characters neither separate words nor start them. */
+		if (is_zerowidth(text + start))
+			;
+		else
+#endif
+		if (!is_word_char(text + start, TRUE))
+			seen_space = TRUE;
+		else if (seen_space) {
+			seen_space = FALSE;
+			count++;
+		}
+
+		start = step_right(text, start);
+	}
+
+	return count;
+}
+
+/* Return the number of words in the given line, counting them only
+ * when they were not counted since the line last changed. */
+size_t words_in(linestruct *line)
+{
+	size_t count;
+
+	if (line->wordcount >= 0)
+		return line->wordcount;
+
+	count = words_between(line->data, 0, strlen(line->data));
+
+	if (count <= INT_MAX)
+		line->wordcount = count;
+
+	return count;
+}
+#endif
+
+/* Return the number of characters (each line break counting as one) or,
+ * when words is TRUE, the number of words in the lines of the current buffer
+ * before the given line.  Next to each entry of the line index a running
+ * total is kept, which is extended from the cached counts of the lines,
+ * so that only lines whose text changed get counted anew. */
+size_t total_before(const linestruct *line, bool words)
+{
+	size_t wanted = (lineno_of(line) - 1) / INDEX_STRIDE;
+	size_t *totals = openfile->charsbefore, *indexed = &openfile->charsindexed;
+	linestruct *ln;
+	size_t sum;
+
+#ifndef NANO_TINY
+	if (words) {
+		totals = openfile->wordsbefore;
+		indexed = &openfile->wordsindexed;
+	}
+#endif
+	/* Make sure that the line index reaches as far as needed. */
+	line_from_number(wanted * INDEX_STRIDE + 1);
+
+	if (*indexed == 0)
+		totals[(*indexed)++] = 0;
+
+	while (*indexed <= wanted) {
+		sum = totals[*indexed - 1];
+		ln = openfile->lineindex[*indexed - 1];
+
+		for (int step = 0; step < INDEX_STRIDE; step++, ln = ln->next)
+#ifndef NANO_TINY
+			sum += (words) ? words_in(ln) : chars_in(ln) + 1;
+#else
+			sum += chars_in(ln) + 1;
+#endif
+		totals[(*indexed)++] = sum;
+	}
+
+	sum = totals[wanted];
+
+	for (ln = openfile->lineindex[wanted]; ln != line; ln = ln->next)
+#ifndef NANO_TINY
+		sum += (words) ? words_in(ln) : chars_in(ln) + 1;
+#else
+		sum += chars_in(ln) + 1;
+#endif
+	return sum;
+}
+
+#ifndef NANO_TINY
+/* Make the bracket depths of the current buffer be about the given pair of
+ * brackets (the opening one first), dropping the ones for another pair. */
+void aim_the_depths_at(const char *pair)
+{
+	if (openfile->depthpair && strcmp(openfile->depthpair, pair) == 0)
+		return;
+
+	for (linestruct *line = openfile->filetop; line != NULL; line = line->next)
+		line->lowestdepth = 1;
+
+	openfile->depthpair = mallocstrcpy(openfile->depthpair, pair);
+	openfile->depthsindexed = 0;
+}
+
+/* Determine, when not known, how much the given line changes the depth of
+ * the indexed pair of brackets, and the lowest depth reached in the line. */
+void measure_the_depths_in(linestruct *line)
+{
+	const char *pair = openfile->depthpair;
+	bool plain = (strlen(pair) == 2);
+	int openlen = char_length(pair);
+	const char *found = line->data;
+	int depth = 0, lowest = 0;
+
+	if (line->lowestdepth <= 0)
+		return;
+
+	/* When both brackets are single bytes, the fast strpbrk() can be used. */
+	while ((found = (plain ? strpbrk(found, pair) : mbstrpbrk(found, pair)))) {
+		if (strncmp(found, pair, openlen) == 0)
+			depth++;
+		else if (--depth < lowest)
+			lowest = depth;
+
+		found += char_length(found);
+	}
+
+	line->depthchange = depth;
+	line->lowestdepth = lowest;
+}
+
+/* Extend the bracket depths beside the line index to cover the given number
+ * of stretches (or all), and with them the table that holds, for each level
+ * k, the lowest depth that is reached in each run of 2^k stretches. */
+void index_the_depths(size_t wanted)
+{
+	size_t stretches = (openfile->totlines + INDEX_STRIDE - 1) / INDEX_STRIDE;
+	size_t was_indexed = openfile->depthsindexed;
+	int had_levels = openfile->depthlevels;
+	linestruct *line;
+
+	if (wanted > stretches)
+		wanted = stretches;
+
+	if (was_indexed >= wanted)
+		return;
+
+	if (openfile->depthroom <= wanted) {
+		openfile->depthroom = wanted + wanted / 2 + 64;
+		openfile->depthbefore = nrealloc(openfile->depthbefore,
+								openfile->depthroom * sizeof(ssize_t));
+
+		while (((size_t)1 << openfile->depthlevels) <= openfile->depthroom)
+			openfile->depthlevels++;
+
+		openfile->lowestdepth = nrealloc(openfile->lowestdepth,
+								openfile->depthlevels * sizeof(ssize_t *));
+
+		for (int level = 0; level < openfile->depthlevels; level++)
+			openfile->lowestdepth[level] = nrealloc((level < had_levels) ?
+								openfile->lowestdepth[level] : NULL,
+								openfile->depthroom * sizeof(ssize_t));
+	}
+
+	/* Make sure that the line index reaches as far as needed. */
+	line_from_number((wanted - 1) * INDEX_STRIDE + 1);
+
+	openfile->depthbefore[0] = 0;
+
+	for (size_t index = was_indexed; index < wanted; index++) {
+		ssize_t depth = openfile->depthbefore[index];
+		ssize_t lowest = depth;
+
+		line = openfile->lineindex[index];
+
+		for (int step = 0; step < INDEX_STRIDE && line != NULL; step++) {
+			measure_the_depths_in(line);
+
+			if (depth + line->lowestdepth < lowest)
+				lowest = depth + line->lowestdepth;
+
+			depth += line->depthchange;
+			line = line->next;
+		}
+
+		openfile->depthbefore[index + 1] = depth;
+		openfile->lowestdepth[0][index] = lowest;
+	}
+
+	/* Fill in the runs that got completed by the new stretches. */
+	for (int level = 1; level < openfile->depthlevels; level++) {
+		size_t span = (size_t)1 << level;
+		size_t index = (level >= had_levels || was_indexed < span) ? 0 :
+												was_indexed - span + 1;
+		ssize_t *lower = openfile->lowestdepth[level - 1];
+
+		for (; index + span <= wanted; index++)
+			openfile->lowestdepth[level][index] = (lower[index] < lower[index + span / 2]) ?
+										lower[index] : lower[index + span / 2];
+	}
+
+	openfile->depthsindexed = wanted;
+}
+
+/* Coming from the given line, return the nearest line further on (or back,
+ * when reverse is TRUE) in which the given balance of brackets can drop to
+ * zero, and set the balance to what it is upon entering that line.  Return
+ * NULL when there is no such line. */
+linestruct *line_that_balances(linestruct *line, bool reverse, size_t *balance)
+{
+	size_t stretch = (lineno_of(line) - 1) / INDEX_STRIDE;
+	linestruct *sought = NULL;
+	ssize_t depth, target;
+	int step = 0;
+
+	index_the_depths(stretch + 1);
+
+	/* Determine the depth at the start of the given line. */
+	depth = openfile->depthbefore[stretch];
+	for (linestruct *ln = openfile->lineindex[stretch]; ln != line; ln = ln->next) {
+		depth += ln->depthchange;
+		step++;
+	}
+
+	if (!reverse) {
+		depth += line->depthchange;
+		target = depth - *balance;
+
+		/* First look at the remaining lines of the same stretch. */
+		for (line = line->next; line != NULL && ++step < INDEX_STRIDE; line = line->next) {
+			if (depth + line->lowestdepth <= target) {
+				*balance = depth - target;
+				return line;
+			}
+			depth += line->depthchange;
+		}
+
+		/* Then skip all following runs of stretches that stay too deep,
+		 * extending the depths further as long as nothing is found. */
+		stretch++;
+
+		while (TRUE) {
+			for (int level = openfile->depthlevels - 1; level >= 0; level--) {
+				size_t span = (size_t)1 << level;
+
+				if (stretch + span <= openfile->depthsindexed &&
+							openfile->lowestdepth[level][stretch] > target)
+					stretch += span;
+			}
+
+			if (stretch < openfile->depthsindexed)
+				break;
+
+			if (openfile->depthsindexed * INDEX_STRIDE >= openfile->totlines)
+				return NULL;
+
+			index_the_depths(2 * openfile->depthsindexed);
+		}
+
+		depth = openfile->depthbefore[stretch];
+		for (line = openfile->lineindex[stretch]; depth + line->lowestdepth > target;
+													line = line->next)
+			depth += line->depthchange;
+
+		*balance = depth - target;
+		return line;
+	}
+
+	target = depth - *balance;
+
+	/* First look at the earlier lines of the same stretch. */
+	depth = openfile->depthbefore[stretch];
+	for (linestruct *ln = openfile->lineindex[stretch]; ln != line; ln = ln->next) {
+		if (depth + ln->lowestdepth <= target)
+			sought = ln;
+		depth += ln->depthchange;
+		if (sought == ln)
+			*balance = depth - target;
+	}
+
+	if (sought)
+		return sought;
+
+	/* Then skip all preceding runs of stretches that stay too deep. */
+	for (int level = openfile->depthlevels - 1; level >= 0; level--) {
+		size_t span = (size_t)1 << level;
+
+		if (stretch >= span && openfile->lowestdepth[level][stretch - span] > target)
+			stretch -= span;
+	}
+
+	if (stretch == 0)
+		return NULL;
+
+	/* The wanted line is the last one in the stretch before that point
+	 * where the depth gets low enough. */
+	stretch--;
+	depth = openfile->depthbefore[stretch];
+	line = openfile->lineindex[stretch];
+
+	for (step = 0; step < INDEX_STRIDE; step++, line = line->next) {
+		if (depth + line->lowestdepth <= target)
+			sought = line;
+		depth += line->depthchange;
+		if (sought == line)
+			*balance = depth - target;
+	}
+
+	return sought;
+}
+
+/* Drop the running totals of extra rows from the given line number onward,
+ * because the amount of extra rows of that line has changed. */
+void forget_rows_from(ssize_t number)
+{
+	size_t keep = (number < 1) ? 0 : (number + INDEX_STRIDE - 1) / INDEX_STRIDE;
+
+	if (keep < openfile->rowsindexed)
+		openfile->rowsindexed = keep;
+}
+
+/* Return the number of extra rows that the lines before the given line need
+ * when softwrapping.  Next to each entry of the line index a running total
+ * is kept, which gets extended as far as needed, like the index itself. */
+size_t extra_rows_before(const linestruct *line)
+{
+	size_t wanted = (lineno_of(line) - 1) / INDEX_STRIDE;
+	const linestruct *ln;
+	size_t sum;
+
+	/* Make sure that the line index reaches as far as needed. */
+	line_from_number(wanted * INDEX_STRIDE + 1);
+
+	if (openfile->rowsindexed == 0)
+		openfile->rowsbefore[openfile->rowsindexed++] = 0;
+
+	while (openfile->rowsindexed <= wanted) {
+		sum = openfile->rowsbefore[openfile->rowsindexed - 1];
+		ln = openfile->lineindex[openfile->rowsindexed - 1];
+
+		for (int step = 0; step < INDEX_STRIDE; step++, ln = ln->next)
+			if (ln->extrarows > 0)
+				sum += ln->extrarows;
+
+		openfile->rowsbefore[openfile->rowsindexed++] = sum;
+	}
+
+	sum = openfile->rowsbefore[wanted];
+
+	for (ln = openfile->lineindex[wanted]; ln != line; ln = ln->next)
+		if (ln->extrarows > 0)
+			sum += ln->extrarows;
+
+	return sum;
 }
 #endif
 
@@ -454,7 +1360,7 @@ void remove_magicline(void)
 /* Return TRUE when the mark is before or at the cursor, and FALSE otherwise. */
 bool mark_is_before_cursor(void)
 {
-	return (openfile->mark->lineno < openfile->current->lineno ||
+	return (lineno_of(openfile->mark) < lineno_of(openfile->current) ||
 						(openfile->mark == openfile->current &&
 						openfile->mark_x <= openfile->current_x));
 }
@@ -496,31 +1402,18 @@ void get_range(linestruct **top, linestruct **bot)
 	}
 }
 
-/* Return a pointer to the line that has the given line number. */
-linestruct *line_from_number(ssize_t number)
-{
-	linestruct *line = openfile->current;
-
-	if (line->lineno > number)
-		while (line->lineno != number)
-			line = line->prev;
-	else
-		while (line->lineno != number)
-			line = line->next;
-
-	return line;
-}
 #endif /* !NANO_TINY */
 
 /* Count the number of characters from begin to end, and return it. */
-size_t number_of_characters_in(const linestruct *begin, const linestruct *end)
+size_t number_of_characters_in(linestruct *begin, const linestruct *end)
 {
-	const linestruct *line;
+	linestruct *line;
 	size_t count = 0;
 
-	/* Sum the number of characters (plus a newline) in each line. */
+	/* Sum the number of characters (plus a newline) in each line,
+	 * using the cached counts where the lines have them. */
 	for (line = begin; line != end->next; line = line->next)
-		count += mbstrlen(line->data) + 1;
+		count += chars_in(line) + 1;
 
 	/* Do not count the final newline. */
 	return (count - 1);
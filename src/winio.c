@@ -42,6 +42,10 @@
 #define USING_OLDER_LIBVTE  yes
 #endif
 
+static int *key_storage = NULL;
+		/* The allocated space in which the keystroke buffer lives. */
+static size_t key_room = 0;
+		/* The number of keycodes that fit in the above space. */
 static int *key_buffer = NULL;
 		/* A buffer for the keystrokes that haven't been handled yet. */
 static size_t key_buffer_len = 0;
@@ -120,7 +124,12 @@ void run_macro(void)
 		return;
 	}
 
-	key_buffer = nrealloc(key_buffer, macro_length * sizeof(int));
+	if (key_room < macro_length) {
+		key_storage = nrealloc(key_storage, macro_length * sizeof(int));
+		key_room = macro_length;
+	}
+
+	key_buffer = key_storage;
 	key_buffer_len = macro_length;
 
 	for (size_t i = 0; i < macro_length; i++)
@@ -189,13 +198,22 @@ void read_keys_from(WINDOW *win)
 		curs_set(1);
 
 #ifndef NANO_TINY
-	if (currmenu == MMAIN && ISSET(MINIBAR) && lastmessage > HUSH &&
+	/* While no keystroke is waiting, count the matches of the last search. */
+	if (currmenu == MMAIN && counting_is_pending())
+		input = count_matches_until_keystroke(win);
+
+	if (input == ERR && currmenu == MMAIN && ISSET(MINIBAR) && lastmessage > HUSH &&
 						lastmessage != INFO && lastmessage < ALERT) {
 		timed = TRUE;
 		halfdelay(ISSET(QUICK_BLANK) ? 8 : 15);
 		disable_kb_interrupt();
 	}
 #endif
+#ifdef ENABLE_BROWSER
+	/* While no keystroke is waiting, continue an ongoing search in files. */
+	if (input == ERR && currmenu == MBROWSER && searching_files())
+		input = search_files_until_keystroke(win);
+#endif
 
 	/* Read in the first keycode, waiting for it to arrive. */
 	while (input == ERR) {
@@ -231,7 +249,12 @@ void read_keys_from(WINDOW *win)
 	curs_set(0);
 
 	/* Initiate the keystroke buffer, and save the keycode in it. */
-	key_buffer = nrealloc(key_buffer, sizeof(int));
+	if (key_room == 0) {
+		key_storage = nmalloc(sizeof(int));
+		key_room = 1;
+	}
+
+	key_buffer = key_storage;
 	key_buffer[0] = input;
 	key_buffer_len = 1;
 
@@ -260,10 +283,15 @@ void read_keys_from(WINDOW *win)
 		if (input == ERR)
 			break;
 
-		/* Extend the keystroke buffer, and save the keycode at its end. */
-		key_buffer_len++;
-		key_buffer = nrealloc(key_buffer, key_buffer_len * sizeof(int));
-		key_buffer[key_buffer_len - 1] = input;
+		/* When the keystroke buffer is full, double its size. */
+		if (key_buffer_len == key_room) {
+			key_room *= 2;
+			key_storage = nrealloc(key_storage, key_room * sizeof(int));
+			key_buffer = key_storage;
+		}
+
+		/* Save the keycode at the end of the keystroke buffer. */
+		key_buffer[key_buffer_len++] = input;
 	}
 
 	/* Restore blocking-input mode. */
@@ -290,15 +318,23 @@ void put_back(int keycode)
 	if (key_buffer_len + 1 < key_buffer_len)
 		return;
 
-	/* Extend the keystroke buffer to make room for the extra keycode. */
-	key_buffer = nrealloc(key_buffer, ++key_buffer_len * sizeof(int));
+	/* When there is no room in front of the keystroke buffer, move its
+	 * content to a new space that has as much room in front as it has. */
+	if (key_buffer == key_storage) {
+		size_t slack = key_buffer_len + 1;
+		int *storage = nmalloc((slack + key_buffer_len) * sizeof(int));
+
+		if (key_buffer_len > 0)
+			memcpy(storage + slack, key_buffer, key_buffer_len * sizeof(int));
 
-	/* If the keystroke buffer wasn't empty before, move all the
-	 * existing content one step further away. */
-	if (key_buffer_len > 1)
-		memmove(key_buffer + 1, key_buffer, (key_buffer_len - 1) * sizeof(int));
+		free(key_storage);
+		key_storage = storage;
+		key_room = slack + key_buffer_len;
+		key_buffer = storage + slack;
+	}
 
-	*key_buffer = keycode;
+	*(--key_buffer) = keycode;
+	key_buffer_len++;
 }
 
 #ifdef ENABLE_NANORC
@@ -328,9 +364,9 @@ int get_input(WINDOW *win)
 	/* Take the first code from the head of the keystroke buffer. */
 	input = key_buffer[0];
 
-	/* If the buffer contains more codes, move them to the front. */
-	if (--key_buffer_len > 0)
-		memmove(key_buffer, key_buffer + 1, key_buffer_len * sizeof(int));
+	/* Step over the code, leaving any further codes where they are. */
+	key_buffer++;
+	key_buffer_len--;
 
 	return input;
 }
@@ -829,8 +865,8 @@ int parse_escape_sequence(int starter)
 #endif
 
 	/* Remove the consumed sequence bytes from the keystroke buffer. */
+	key_buffer += consumed;
 	key_buffer_len -= consumed;
-	memmove(key_buffer, key_buffer + consumed, key_buffer_len * sizeof(int));
 
 	return keycode;
 }
@@ -2109,7 +2145,7 @@ void minibar(void)
 	} else
 		thename = copy_of(_("(nameless)"));
 
-	sprintf(location, "%zi,%zi", openfile->current->lineno, xplustabs() + 1);
+	sprintf(location, "%zi,%zi", lineno_of(openfile->current), xplustabs() + 1);
 	placewidth = strlen(location);
 	namewidth = breadth(thename);
 
@@ -2133,7 +2169,7 @@ void minibar(void)
 	/* Right after reading or writing a file, display its number of lines;
 	 * otherwise, when there a mutiple buffers, display an [x/n] counter. */
 	if (report_size && COLS > 35) {
-		size_t count = openfile->filebot->lineno - (openfile->filebot->data[0] == '\0');
+		size_t count = lineno_of(openfile->filebot) - (openfile->filebot->data[0] == '\0');
 
 		number_of_lines = nmalloc(44);
 		sprintf(number_of_lines, P_(" (%zu line)", " (%zu lines)", count), count);
@@ -2208,7 +2244,7 @@ void minibar(void)
 
 	/* Display how many percent the current line is into the file. */
 	if (namewidth + 6 < COLS) {
-		sprintf(location, "%3zi%%", 100 * openfile->current->lineno / openfile->filebot->lineno);
+		sprintf(location, "%3zi%%", 100 * lineno_of(openfile->current) / lineno_of(openfile->filebot));
 		mvwaddstr(bottomwin, 0, COLS - 4 - padding, location);
 	}
 
@@ -2444,7 +2480,7 @@ void place_the_cursor(void)
 	} else
 #endif
 	{
-		row = openfile->current->lineno - openfile->edittop->lineno;
+		row = lineno_of(openfile->current) - lineno_of(openfile->edittop);
 		column -= get_page_start(column);
 	}
 
@@ -2474,7 +2510,7 @@ void draw_row(int row, const char *converted, linestruct *line, size_t from_col)
 			mvwprintw(edit, row, 0, "%*s", margin - 1, " ");
 		else
 #endif
-			mvwprintw(edit, row, 0, "%*zd", margin - 1, line->lineno);
+			mvwprintw(edit, row, 0, "%*zd", margin - 1, lineno_of(line));
 		wattroff(edit, interface_color_pair[LINE_NUMBER]);
 #ifndef NANO_TINY
 		if (line->has_anchor && (from_col == 0 || !ISSET(SOFTWRAP)))
@@ -2507,10 +2543,10 @@ void draw_row(int row, const char *converted, linestruct *line, size_t from_col)
 	/* If there are color rules (and coloring is turned on), apply them. */
 	if (openfile->syntax && !ISSET(NO_SYNTAX)) {
 		const colortype *varnish = openfile->syntax->color;
-
-		/* If there are multiline regexes, make sure this line has a cache. */
-		if (openfile->syntax->nmultis > 0 && line->multidata == NULL)
-			line->multidata = nmalloc(openfile->syntax->nmultis * sizeof(short));
+		const paintstruct *paint = paint_of(line, till_x);
+			/* The spans that the single-line rules paint on this line. */
+		size_t paintee = 0;
+			/* The span of the above that is next in turn. */
 
 		/* Iterate through all the coloring regexes. */
 		for (; varnish != NULL; varnish = varnish->next) {
@@ -2522,8 +2558,6 @@ void draw_row(int row, const char *converted, linestruct *line, size_t from_col)
 				/* The number of characters to paint. */
 			const char *thetext;
 				/* The place in converted from where painting starts. */
-			regmatch_t match;
-				/* The match positions of a single-line regex. */
 			const linestruct *start_line = line->prev;
 				/* The first line before line that matches 'start'. */
 			linestruct *end_line = line;
@@ -2533,40 +2567,21 @@ void draw_row(int row, const char *converted, linestruct *line, size_t from_col)
 
 			/* First case: varnish is a single-line expression. */
 			if (varnish->end == NULL) {
-				while (index < till_x) {
-					/* If there is no match, go on to the next line. */
-					if (regexec(varnish->start, &line->data[index], 1,
-								&match, (index == 0) ? 0 : REG_NOTBOL) != 0)
-						break;
-
-					/* Translate the match to the beginning of the line. */
-					match.rm_so += index;
-					match.rm_eo += index;
-					index = match.rm_eo;
-
-					/* If the match is offscreen to the right, this rule is done. */
-					if (match.rm_so >= till_x)
-						break;
-
-					/* If the match has length zero, advance over it. */
-					if (match.rm_so == match.rm_eo) {
-						if (line->data[index] == '\0')
-							break;
-						index = step_right(line->data, index);
-						continue;
-					}
+				for (; paintee < paint->count &&
+							paint->spans[paintee].rule == varnish; paintee++) {
+					const spanstruct *span = &paint->spans[paintee];
 
-					/* If the match is offscreen to the left, skip to next. */
-					if (match.rm_eo <= from_x)
+					/* If the match is offscreen to either side, skip it. */
+					if (span->start >= till_x || span->end <= from_x)
 						continue;
 
-					if (match.rm_so > from_x)
-						start_col = wideness(line->data, match.rm_so) - from_col;
+					if (span->start > from_x)
+						start_col = wideness(line->data, span->start) - from_col;
 
 					thetext = converted + actual_x(converted, start_col);
 
 					paintlen = actual_x(thetext, wideness(line->data,
-										match.rm_eo) - from_col - start_col);
+										span->end) - from_col - start_col);
 
 					wattron(edit, varnish->attributes);
 					mvwaddnstr(edit, row, margin + start_col, thetext, paintlen);
@@ -2579,18 +2594,16 @@ void draw_row(int row, const char *converted, linestruct *line, size_t from_col)
 			/* Second case: varnish is a multiline expression. */
 
 			/* Assume nothing gets painted until proven otherwise below. */
-			line->multidata[varnish->id] = NOTHING;
+			set_multistate(line, varnish->id, NOTHING);
 
 			/* Apart from the first row, check the multidata of the preceding line:
 			 * it tells us about the situation so far, and thus what to do here. */
-			if (row > 0 && start_line != NULL && start_line->multidata != NULL) {
-				if (start_line->multidata[varnish->id] == WHOLELINE ||
-						start_line->multidata[varnish->id] == STARTSHERE ||
-						start_line->multidata[varnish->id] == WOULDBE)
+			if (row > 0 && start_line != NULL) {
+				short state = multistate_of(start_line, varnish->id);
+
+				if (state == WHOLELINE || state == STARTSHERE || state == WOULDBE)
 					goto seek_an_end;
-				if (start_line->multidata[varnish->id] == NOTHING ||
-						start_line->multidata[varnish->id] == ENDSHERE ||
-						start_line->multidata[varnish->id] == JUSTONTHIS)
+				if (state == NOTHING || state == ENDSHERE || state == JUSTONTHIS)
 					goto step_two;
 			}
 
@@ -2599,11 +2612,13 @@ void draw_row(int row, const char *converted, linestruct *line, size_t from_col)
 
 			/* First step: see if there is a line before current that
 			 * matches 'start' and is not complemented by an 'end'. */
-			while (start_line != NULL && regexec(varnish->start,
-						start_line->data, 1, &startmatch, 0) == REG_NOMATCH) {
+			while (start_line != NULL && (!could_match(start_line->data,
+						varnish->needle, varnish->caseless) || regexec(varnish->start,
+						start_line->data, 1, &startmatch, 0) == REG_NOMATCH)) {
 				/* There is no start on this line; but if there is an end,
 				 * there is no need to look for starts on earlier lines. */
-				if (regexec(varnish->end, start_line->data, 0, NULL, 0) == 0)
+				if (could_match(start_line->data, varnish->endneedle, varnish->caseless) &&
+						regexec(varnish->end, start_line->data, 0, NULL, 0) == 0)
 					goto step_two;
 				start_line = start_line->prev;
 			}
@@ -2613,9 +2628,8 @@ void draw_row(int row, const char *converted, linestruct *line, size_t from_col)
 				goto step_two;
 
 			/* If the start has been qualified as an end earlier, believe it. */
-			if (start_line->multidata != NULL &&
-						(start_line->multidata[varnish->id] == ENDSHERE ||
-						start_line->multidata[varnish->id] == JUSTONTHIS))
+			if (multistate_of(start_line, varnish->id) == ENDSHERE ||
+						multistate_of(start_line, varnish->id) == JUSTONTHIS)
 				goto step_two;
 
 			/* Maybe there is an end on that same line?  If yes, maybe
@@ -2647,22 +2661,23 @@ void draw_row(int row, const char *converted, linestruct *line, size_t from_col)
 			 * and the current line.  But is there an end after the start
 			 * at all?  Because we don't paint unterminated starts. */
 			if (row == 0) {
-				while (end_line != NULL && regexec(varnish->end, end_line->data,
-											1, &endmatch, 0) == REG_NOMATCH)
+				while (end_line != NULL && (!could_match(end_line->data,
+							varnish->endneedle, varnish->caseless) || regexec(varnish->end,
+							end_line->data, 1, &endmatch, 0) == REG_NOMATCH))
 					end_line = end_line->next;
 			} else if (regexec(varnish->end, line->data, 1, &endmatch, 0) != 0)
 				end_line = line->next;
 
 			/* If there is no end, there is nothing to paint. */
 			if (end_line == NULL) {
-				line->multidata[varnish->id] = WOULDBE;
+				set_multistate(line, varnish->id, WOULDBE);
 				continue;
 			}
 
 			/* If it was already determined that there is no end... */
-			if (end_line != line && line->prev == start_line && line->prev->multidata &&
-								line->prev->multidata[varnish->id] == WOULDBE) {
-				line->multidata[varnish->id] = WOULDBE;
+			if (end_line != line && line->prev == start_line &&
+								multistate_of(line->prev, varnish->id) == WOULDBE) {
+				set_multistate(line, varnish->id, WOULDBE);
 				continue;
 			}
 
@@ -2671,7 +2686,7 @@ void draw_row(int row, const char *converted, linestruct *line, size_t from_col)
 				wattron(edit, varnish->attributes);
 				mvwaddnstr(edit, row, margin, converted, -1);
 				wattroff(edit, varnish->attributes);
-				line->multidata[varnish->id] = WHOLELINE;
+				set_multistate(line, varnish->id, WHOLELINE);
 				continue;
 			}
 
@@ -2683,7 +2698,7 @@ void draw_row(int row, const char *converted, linestruct *line, size_t from_col)
 				mvwaddnstr(edit, row, margin, converted, paintlen);
 				wattroff(edit, varnish->attributes);
 			}
-			line->multidata[varnish->id] = ENDSHERE;
+			set_multistate(line, varnish->id, ENDSHERE);
 
   step_two:
 			/* Second step: look for starts on this line, but begin
@@ -2716,7 +2731,7 @@ void draw_row(int row, const char *converted, linestruct *line, size_t from_col)
 						mvwaddnstr(edit, row, margin + start_col, thetext, paintlen);
 						wattroff(edit, varnish->attributes);
 
-						line->multidata[varnish->id] = JUSTONTHIS;
+						set_multistate(line, varnish->id, JUSTONTHIS);
 					}
 					index = endmatch.rm_eo;
 					/* If both start and end match are anchors, advance. */
@@ -2732,13 +2747,14 @@ void draw_row(int row, const char *converted, linestruct *line, size_t from_col)
 				/* There is no end on this line.  But maybe on later lines? */
 				end_line = line->next;
 
-				while (end_line && regexec(varnish->end, end_line->data,
-											0, NULL, 0) == REG_NOMATCH)
+				while (end_line && (!could_match(end_line->data, varnish->endneedle,
+							varnish->caseless) || regexec(varnish->end, end_line->data,
+											0, NULL, 0) == REG_NOMATCH))
 					end_line = end_line->next;
 
 				/* If there is no end, we're done with this regex. */
 				if (end_line == NULL) {
-					line->multidata[varnish->id] = WOULDBE;
+					set_multistate(line, varnish->id, WOULDBE);
 					break;
 				}
 
@@ -2747,14 +2763,9 @@ void draw_row(int row, const char *converted, linestruct *line, size_t from_col)
 				mvwaddnstr(edit, row, margin + start_col, thetext, -1);
 				wattroff(edit, varnish->attributes);
 
-				line->multidata[varnish->id] = STARTSHERE;
+				set_multistate(line, varnish->id, STARTSHERE);
 
-				if (end_line->multidata == NULL) {
-					end_line->multidata = nmalloc(openfile->syntax->nmultis * sizeof(short));
-					for (short item = 0; item < openfile->syntax->nmultis; item++)
-						end_line->multidata[item] = 0;
-				}
-				end_line->multidata[varnish->id] = ENDSHERE;
+				set_multistate(end_line, varnish->id, ENDSHERE);
 
 				break;
 			}
@@ -2795,10 +2806,10 @@ void draw_row(int row, const char *converted, linestruct *line, size_t from_col)
 	}
 
 	/* If the line is at least partially selected, paint the marked part. */
-	if (openfile->mark && ((line->lineno >= openfile->mark->lineno &&
-						line->lineno <= openfile->current->lineno) ||
-						(line->lineno <= openfile->mark->lineno &&
-						line->lineno >= openfile->current->lineno))) {
+	if (openfile->mark && ((lineno_of(line) >= lineno_of(openfile->mark) &&
+						lineno_of(line) <= lineno_of(openfile->current)) ||
+						(lineno_of(line) <= lineno_of(openfile->mark) &&
+						lineno_of(line) >= lineno_of(openfile->current)))) {
 		linestruct *top, *bot;
 			/* The lines where the marked region begins and ends. */
 		size_t top_x, bot_x;
@@ -2812,9 +2823,9 @@ void draw_row(int row, const char *converted, linestruct *line, size_t from_col)
 
 		get_region(&top, &top_x, &bot, &bot_x);
 
-		if (top->lineno < line->lineno || top_x < from_x)
+		if (lineno_of(top) < lineno_of(line) || top_x < from_x)
 			top_x = from_x;
-		if (bot->lineno > line->lineno || bot_x > till_x)
+		if (lineno_of(bot) > lineno_of(line) || bot_x > till_x)
 			bot_x = till_x;
 
 		/* Only paint if the marked part of the line is on this page. */
@@ -2861,7 +2872,10 @@ int update_line(linestruct *line, size_t index)
 	sequel_column = 0;
 #endif
 
-	row = line->lineno - openfile->edittop->lineno;
+	row = lineno_of(line) - lineno_of(openfile->edittop);
+#ifndef NANO_TINY
+	plant_checkpoints_in(line);
+#endif
 	from_col = get_page_start(wideness(line->data, index));
 
 	/* Expand the piece to be drawn to its representable form, and draw it. */
@@ -2907,6 +2921,11 @@ int update_softwrapped_line(linestruct *line)
 	bool end_of_line = FALSE;
 		/* Becomes TRUE when the last chunk of the line has been reached. */
 
+	/* Recount the chunks of the line when it was not yet counted, or when
+	 * the width of the edit window has changed since it was last counted. */
+	if (line->extrarows < 0 || line->countedcols != editwincols)
+		compute_the_extra_rows_of(line);
+
 	if (line == openfile->edittop)
 		from_col = openfile->firstcolumn;
 	else
@@ -3049,27 +3068,24 @@ bool less_than_a_screenful(size_t was_lineno, size_t was_leftedge)
 		size_t leftedge = leftedge_for(xplustabs(), openfile->current);
 		int rows_left = go_back_chunks(editwinrows - 1, &line, &leftedge);
 
-		return (rows_left > 0 || line->lineno < was_lineno ||
-				(line->lineno == was_lineno && leftedge <= was_leftedge));
+		return (rows_left > 0 || lineno_of(line) < was_lineno ||
+				(lineno_of(line) == was_lineno && leftedge <= was_leftedge));
 	} else
 #endif
-		return (openfile->current->lineno - was_lineno < editwinrows);
+		return (lineno_of(openfile->current) - was_lineno < editwinrows);
 }
 
 #ifndef NANO_TINY
 /* Draw a scroll bar on the righthand side of the screen. */
 void draw_scrollbar(void)
 {
-	int totalrows = openfile->filebot->lineno;
-	int first_row = openfile->edittop->lineno;
+	int totalrows = lineno_of(openfile->filebot);
+	int first_row = lineno_of(openfile->edittop);
 
 	if (ISSET(SOFTWRAP)) {
-		for (linestruct *ln = openfile->filetop; ln != openfile->edittop; ln = ln->next)
-			first_row += ln->extrarows;
-		first_row += chunk_for(openfile->firstcolumn, openfile->edittop);
-
-		for (linestruct *ln = openfile->filetop; ln != NULL; ln = ln->next)
-			totalrows += ln->extrarows;
+		first_row += extra_rows_before(openfile->edittop) +
+							chunk_for(openfile->firstcolumn, openfile->edittop);
+		totalrows += openfile->extrasum;
 	}
 
 	int lowest = ((first_row - 1) * editwinrows) / totalrows;
@@ -3297,12 +3313,12 @@ bool current_is_above_screen(void)
 	if (ISSET(SOFTWRAP))
 		/* The cursor is above screen when current[current_x] is before edittop
 		 * at column firstcolumn. */
-		return (openfile->current->lineno < openfile->edittop->lineno ||
-				(openfile->current->lineno == openfile->edittop->lineno &&
+		return (lineno_of(openfile->current) < lineno_of(openfile->edittop) ||
+				(lineno_of(openfile->current) == lineno_of(openfile->edittop) &&
 				xplustabs() < openfile->firstcolumn));
 	else
 #endif
-		return (openfile->current->lineno < openfile->edittop->lineno);
+		return (lineno_of(openfile->current) < lineno_of(openfile->edittop));
 }
 
 /* Return TRUE if current[current_x] is below the bottom of the screen, and
@@ -3317,14 +3333,14 @@ bool current_is_below_screen(void)
 		/* If current[current_x] is more than a screen's worth of lines after
 		 * edittop at column firstcolumn, it's below the screen. */
 		return (go_forward_chunks(editwinrows - 1, &line, &leftedge) == 0 &&
-						(line->lineno < openfile->current->lineno ||
-						(line->lineno == openfile->current->lineno &&
+						(lineno_of(line) < lineno_of(openfile->current) ||
+						(lineno_of(line) == lineno_of(openfile->current) &&
 						leftedge < leftedge_for(xplustabs(),
 												openfile->current))));
 	} else
 #endif
-		return (openfile->current->lineno >=
-						openfile->edittop->lineno + editwinrows);
+		return (lineno_of(openfile->current) >=
+						lineno_of(openfile->edittop) + editwinrows);
 }
 
 /* Return TRUE if current[current_x] is offscreen relative to edittop, and
@@ -3357,7 +3373,7 @@ void edit_redraw(linestruct *old_current, update_type manner)
 		while (line != openfile->current) {
 			update_line(line, 0);
 
-			line = (line->lineno > openfile->current->lineno) ?
+			line = (lineno_of(line) > lineno_of(openfile->current)) ?
 						line->prev : line->next;
 		}
 	} else
@@ -3487,26 +3503,21 @@ void report_cursor_position(void)
 	size_t fullwidth = breadth(openfile->current->data) + 1;
 	size_t column = xplustabs() + 1;
 	int linepct, colpct, charpct;
-	char saved_byte;
 	size_t sum;
 
-	saved_byte = openfile->current->data[openfile->current_x];
-	openfile->current->data[openfile->current_x] = '\0';
-
 	/* Determine the size of the file up to the cursor. */
-	sum = number_of_characters_in(openfile->filetop, openfile->current);
-
-	openfile->current->data[openfile->current_x] = saved_byte;
+	sum = total_before(openfile->current, FALSE) + chars_in(openfile->current) -
+						mbstrlen(openfile->current->data + openfile->current_x);
 
 	/* Calculate the percentages. */
-	linepct = 100 * openfile->current->lineno / openfile->filebot->lineno;
+	linepct = 100 * lineno_of(openfile->current) / lineno_of(openfile->filebot);
 	colpct = 100 * column / fullwidth;
 	charpct = (openfile->totsize == 0) ? 0 : 100 * sum / openfile->totsize;
 
 	statusline(INFO,
 			_("line %*zd/%zd (%2d%%), col %2zu/%2zu (%3d%%), char %*zu/%zu (%2d%%)"),
-			digits(openfile->filebot->lineno),
-			openfile->current->lineno, openfile->filebot->lineno, linepct,
+			digits(lineno_of(openfile->filebot)),
+			lineno_of(openfile->current), lineno_of(openfile->filebot), linepct,
 			column, fullwidth, colpct,
 			digits(openfile->totsize), sum, openfile->totsize, charpct);
 }
@@ -871,7 +871,7 @@ void send_to_server(int signum) {
     sprintf(buffer,"caught SIGALARM %s",ctime (&mytime));
     statusline(HUSH, buffer);
 #endif
-    ycmd_event_file_ready_to_parse(openfile->current_x,(long)openfile->current->lineno,openfile->filename,openfile->filetop);
+    ycmd_event_file_ready_to_parse(openfile->current_x,(long)lineno_of(openfile->current),openfile->filename,openfile->filetop);
 }
 
 void ycmd_init()
@@ -1547,22 +1547,116 @@ void ycmd_gen_extra_conf(char *filepath, char *content)
 
 }
 
-void _ycmd_json_replace_file_data(char **json, char *filepath, char *content)
+void _ycmd_get_abs_filepath(char *filepath, char *abs_filepath)
 {
 	if (filepath[0] != '/')
 	{
-		char abs_filepath[PATH_MAX];
 		getcwd(abs_filepath, PATH_MAX);
 		strcat(abs_filepath,"/");
 		strcat(abs_filepath,filepath);
-		string_replace_w(json, "FILEPATH", abs_filepath, 1);
 	}
 	else
-		string_replace_w(json, "FILEPATH", filepath, 1);
+		strcpy(abs_filepath, filepath);
+}
+
+//finds the open buffer that owns the given lines
+openfilestruct *_ycmd_find_buffer(linestruct *filetop)
+{
+#ifdef ENABLE_MULTIBUFFER
+	openfilestruct *buffer = openfile;
+
+	do
+	{
+		if (buffer->filetop == filetop)
+			return buffer;
+		buffer = buffer->next;
+	} while (buffer != openfile);
+
+	return NULL;
+#else
+	return (openfile->filetop == filetop) ? openfile : NULL;
+#endif
+}
+
+//builds the file_data entries for the other open buffers with unsaved edits that ycmd hasn't seen yet
+//buffers whose version didn't change since they were last sent are left out so they are not resent every tick
+//returned value must be free()
+char *_ycmd_get_other_file_data(char *filepath)
+{
+	char *other_file_data = strdup("");
+#ifdef ENABLE_MULTIBUFFER
+	size_t len = 0;
+	openfilestruct *buffer = openfile;
+
+	do
+	{
+		if (strcmp(buffer->filename, filepath) == 0)
+			buffer->ycmd_sent_version = buffer->version; //sent as the main file
+		else if (buffer->modified && buffer->filename[0] != '\0' && buffer->version != buffer->ycmd_sent_version)
+		{
+			char abs_filepath[PATH_MAX];
+			_ycmd_get_abs_filepath(buffer->filename, abs_filepath);
+
+			char *content = get_all_content(buffer->filetop);
+			char *ft = _ycmd_get_filetype(buffer->filename, content);
+
+			char *format = ","
+				"		\"%s\": {"
+				"                \"contents\": \"%s\","
+				"                \"filetypes\": [\"%s\"]"
+				"        	}";
+			size_t entry_len = strlen(format) + strlen(abs_filepath) + strlen(content) + strlen(ft);
+
+			other_file_data = realloc(other_file_data, len + entry_len + 1);
+			len += sprintf(other_file_data + len, format, abs_filepath, content, ft);
+
+#ifdef DEBUG
+			fprintf(stderr, "Including unsaved buffer %s version %zd in file_data\n", abs_filepath, buffer->version);
+#endif
+			buffer->ycmd_sent_version = buffer->version;
+			free(content);
+		}
+		buffer = buffer->next;
+	} while (buffer != openfile);
+#endif
+
+	return other_file_data;
+}
+
+//a freshly started server has seen none of the buffers, so forget which versions were parsed or sent
+void _ycmd_forget_sent_versions()
+{
+	if (openfile == NULL)
+		return;
+#ifdef ENABLE_MULTIBUFFER
+	openfilestruct *buffer = openfile;
+
+	do
+	{
+		buffer->ycmd_parsed_version = (size_t)-1;
+		buffer->ycmd_sent_version = 0;
+		buffer = buffer->next;
+	} while (buffer != openfile);
+#else
+	openfile->ycmd_parsed_version = (size_t)-1;
+	openfile->ycmd_sent_version = 0;
+#endif
+}
+
+void _ycmd_json_replace_file_data(char **json, char *filepath, char *content)
+{
+	char abs_filepath[PATH_MAX];
+	_ycmd_get_abs_filepath(filepath, abs_filepath);
+	string_replace_w(json, "FILEPATH", abs_filepath, 1);
 
 	char *ft = _ycmd_get_filetype(filepath, content);
 	string_replace_w(json, "FILETYPES", ft, 0);
 
+	//the other buffers go in before CONTENTS so that text inside them is never taken for a placeholder
+	char *other_file_data = _ycmd_get_other_file_data(filepath);
+	string_replace_w(json, "OTHER_FILE_DATA", other_file_data, 0);
+	free(other_file_data);
+
 	string_replace_w(json, "CONTENTS", content, 0);
 }
 
@@ -1592,7 +1686,7 @@ int ycmd_json_event_notification(int columnnum, int linenum, char *filepath, cha
 		"		\"FILEPATH\": {"
 		"                \"contents\": \"CONTENTS\","
 		"                \"filetypes\": [\"FILETYPES\"]"
-		"        	}"
+		"        	}OTHER_FILE_DATA"
 		"	 },"
 		"        \"filepath\": \"FILEPATH\","
 		"        \"line_num\": LINE_NUM"
@@ -1783,7 +1877,7 @@ int ycmd_req_completions_suggestions(int linenum, int columnnum, char *filepath,
 		"		\"FILEPATH\": {"
 		"                \"contents\": \"CONTENTS\","
 		"                \"filetypes\": [\"FILETYPES\"]"
-		"        	}"
+		"        	}OTHER_FILE_DATA"
 		"	 },"
 		"        \"completer_target\": \"COMPLETER_TARGET\""
 		"}";
@@ -1964,7 +2058,7 @@ void _do_completer_command(char *completercommand, COMPLETER_COMMAND_RESULTS *cc
 #endif
 		}
 
-		int ret = ycmd_req_run_completer_command((long)openfile->current->lineno, openfile->current_x, openfile->filename, content, ft, completercommand, ccr);
+		int ret = ycmd_req_run_completer_command((long)lineno_of(openfile->current), openfile->current_x, openfile->filename, content, ft, completercommand, ccr);
 		if (ret == 0)
 		{
 #ifdef DEBUG
@@ -2778,7 +2872,7 @@ void do_completer_command_restartserver(void)
 
 		COMPLETER_COMMAND_RESULTS ccr;
 		init_completer_command_results(&ccr);
-		ycmd_req_run_completer_command((long)openfile->current->lineno, openfile->current_x, openfile->filename, content, ft, completercommand, &ccr);
+		ycmd_req_run_completer_command((long)lineno_of(openfile->current), openfile->current_x, openfile->filename, content, ft, completercommand, &ccr);
 
 		if (is_c_family(ft))
 			ycmd_req_ignore_extra_conf_file(path_extra_conf);
@@ -3042,7 +3136,7 @@ int ycmd_req_run_completer_command(int linenum, int columnnum, char *filepath, c
 		"		\"FILEPATH\": {"
 		"                \"filetypes\": [\"FILETYPES\"],"
 		"                \"contents\": \"CONTENTS\""
-		"        	}"
+		"        	}OTHER_FILE_DATA"
 		"	 }"
 		"}";
 
@@ -3314,7 +3408,7 @@ int _ycmd_req_simple_request(char *method, char *path, int linenum, int columnnu
 		"		\"FILEPATH\": {"
 		"                \"contents\": \"CONTENTS\","
 		"                \"filetypes\": [\"FILETYPES\"]"
-		"        	}"
+		"        	}OTHER_FILE_DATA"
 		"	 }"
 		"}";
 	char *json;
@@ -3394,7 +3488,7 @@ int ycmd_req_defined_subcommands(int linenum, int columnnum, char *filepath, cha
 		"		\"FILEPATH\": {"
 		"                \"filetypes\": [\"FILETYPES\"],"
 		"                \"contents\": \"CONTENTS\""
-		"        	}"
+		"        	}OTHER_FILE_DATA"
 		"	 }"
 		"}";
 
@@ -3606,6 +3700,8 @@ void ycmd_start_server()
 	fprintf(stderr, "Server will be running on http://localhost:%d\n", ycmd_globals.port);
 #endif
 
+	_ycmd_forget_sent_versions();
+
 	ycmd_globals.json = ycmd_create_default_json();
 
 	string_replace_w(&ycmd_globals.json, "HMAC_SECRET", ycmd_globals.secret_key_base64, 0);
@@ -4030,574 +4126,59 @@ char *ycmd_compute_response(char *response_body)
 	return b64_response;
 }
 
-#if USE_OPENMP
-//the final length measured can be like 197466 bytes for this file so simd and multicore seems reasonable to use versus the naive algorithm.
-//use multicore and simd to count the number of start sequence
-size_t _predict_new_json_escape_size_multicore(char **buffer)
+//the number of bytes a character takes up after it is escaped
+static inline int _json_escape_width(char c)
 {
-	int i = 0;
-	int len = strlen(*buffer);
-
-	size_t outlen = 0;
-	outlen = 1;
-	size_t outlen_sum = 0;
-
-	int stop = 0;
-	int resume_i = 0;
-	int resume_ii = 0; //used for initializing for loop initilizer variable because can have variable listed twice in pragma
-
-	char *p = *buffer;
+	if (c == '\\' || ('\b' <= c && c <= '\r') || c == '\"' || c == '/') // \\   //escape already escape
+		return 2;
+	else if (('\x01' <= c && c <= '\x1f') /* || p[i] == 0x7f delete char */) //escape control characters
+		return 6;
+	else
+		return 1;
+}
 
-#ifdef DEBUG
-	fprintf(stderr, "len=%d\n",len);
-	fprintf(stderr, "before avx512 resume_ii=%d outlen_sum=%zd\n",resume_ii,outlen_sum);
-#endif
+//writes the escaped form of c into out and returns the number of bytes written
+static inline int _json_escape_char(char c, char *out)
+{
+	static const char hex[] = "0123456789abcdef";
 
-#ifdef __AVX512__
-	#pragma omp parallel for \
-		default(none) \
-		reduction(+:outlen,resume_i) \
-		shared(p,len,stderr) \
-		firstprivate(stop,resume_ii) \
-		private(i)
-	for (i = resume_ii; i < len; i+=64)
+	//reduce the number of comparisons because switch case in assembly is just test jump statements
+	//the original had 34 case statements so 34 test instructions... currently have 9 test instructions with the if/else chain
+	if (c == '\\') // \\   //escape already escape
 	{
-		if (len-i <= 64)
-		{
-			stop = 1;
-		}
-
-		if (!stop)
-		{
-#ifdef DEBUG
-			fprintf(stderr, "i=%d running multicore avx512 threadid=%d\n",i,omp_get_thread_num());
-#endif
-
-			//use simd to compare by chunks
-			//sse doesn't have an lt
-
-			//compare 64 at a time instead of 1 at a time
-
-			__m512i chunk;
-			memcpy(&chunk, i+p, 64);
-			__mmask64 r0,r1,r2,r3,rf0,rf1,rf2,rf3,rf4;
-
-			//check 2 byte sequences
-			__m512i c0 = _mm512_set1_epi8('\\'); //5c
-			__m512i c1 = _mm512_set1_epi8('\"'); //22
-			__m512i c2 = _mm512_set1_epi8('/'); //2f
-			r0 = _mm512_cmpeq_epi8_mask(chunk,c0);
-			r1 = _mm512_cmpeq_epi8_mask(chunk,c1);
-			r2 = _mm512_cmpeq_epi8_mask(chunk,c2);
-			rf0 = r0 | r1 | r2; //final
-
-			__m512i c3 = _mm512_set1_epi8('\b'); //08
-			rf1 = _mm512_cmple_epu8_mask(c3,chunk);
-			__m512i c4 = _mm512_set1_epi8('\r'); //0d
-			rf2 = _mm512_cmple_epu8_mask(chunk,c4);
-			rf3 = rf1 & rf2; //final
-
-			int c;
-			c = 0;
-			__mmask64 result;
-			result = rf0 | rf3;
-			if (result)
-			{
-				c = __builtin_popcountll(result);
-				outlen += c*2;
-			}
-			outlen += 64-c;
-
-			//check 6 byte sequences
-			__m512i c5 = _mm512_set1_epi8('\x01');
-			rf1 = _mm512_cmple_epu8_mask(c3,chunk);
-			__m512i c6 = _mm512_set1_epi8('\x1f');
-			rf2 = _mm512_cmple_epu8_mask(chunk,c4);
-			result = rf1 & rf2; //final
-
-			c = 0;
-			if (result)
-			{
-				c = __builtin_popcountll(result);
-				outlen += c*6;
-			}
-			outlen += 64-c;
-
-			resume_i+=64;
-
-#ifdef DEBUG
-			fprintf(stderr, "i=%d running multicore avx512 threadid=%d outlen=%zd\n",i,omp_get_thread_num(),outlen);
-#endif
-		}
+		memcpy(out, "\\\\", 2);
+		return 2;
 	}
-#endif
-
-	if (resume_i)
-		resume_ii+=resume_i;
-	resume_i = 0;
-
-	if (outlen)
-		outlen_sum+=outlen;
-	outlen = 0;
-
-
-#ifdef DEBUG
-	fprintf(stderr, "before avx2 resume_ii=%d outlen_sum=%zd\n",resume_ii, outlen_sum);
-#endif
-	assert(outlen_sum>=resume_ii);
-
-	stop = 0;
-
-#ifdef __AVX2__
-	#pragma omp parallel for \
-		default(none) \
-		reduction(+:outlen,resume_i) \
-		shared(p,len,stderr) \
-		firstprivate(stop,resume_ii) \
-		private(i)
-	for (i = resume_ii; i < len; i+=32)
+	else if ('\b' <= c && c <= '\r') // c escape sequences
 	{
-		if (len-i <= 32)
-		{
-			stop = 1;
-		}
-
-		if (!stop)
-		{
-#ifdef DEBUG
-			fprintf(stderr, "i=%d running multicore avx2 threadid=%d\n",i,omp_get_thread_num());
-#endif
-
-			//compare 32 at a time instead of 1 at a time
-			__m256i chunk;
-			memcpy(&chunk, i+p, 32);
-			__mmask64 r0,r1,r2,r3,rf0,rf1,rf2,rf3,rf4;
-
-			//avx2 doesn't support cmplt <
-			//since avx2 doesn't support < or <= we have to use logical eqivalence to get the same effect
-			// 1 <= 2 <= 3 which is logically equivalent to 1 <= 2 && 2 <= 3
-			//is logical equivalent and consistent as 3>= 2 && 2 >= 1
-			// 3 >= 2 >= 1
-
-			//check 2 byte sequences
-			__m256i c0 = _mm256_set1_epi8('\\'); //5c
-			__m256i c1 = _mm256_set1_epi8('\"'); //22
-			__m256i c2 = _mm256_set1_epi8('/'); //2f
-			r0 = _mm256_cmpeq_epi8(chunk,c0);
-			r1 = _mm256_cmpeq_epi8(chunk,c1);
-			r2 = _mm256_cmpeq_epi8(chunk,c2);
-			rf0 = _mm256_or_si256(r0, r1);
-			rf0 = _mm256_or_si256(rf0, r2); //final
-
-			__m256i c3 = _mm256_set1_epi8('\r'); //0d
-			r0 = _mm256_cmpgt_epi8(c3,chunk);
-			r1 = _mm256_cmpeq_epi8(c3,chunk);
-			rf1 = _mm256_or_si256(r0,r1);
-			__m256i c4 = _mm256_set1_epi8('\b'); //08
-			r2 = _mm256_cmpgt_epi8(chunk,c4);
-			r3 = _mm256_cmpeq_epi8(chunk,c4);
-			rf2 = _mm256_or_si256(r2,r3);
-			rf3 = _mm256_and_si256(rf1,rf2); //final
-
-			rf0 = _mm256_or_si256(rf0, rf3); //final final
-
-			int c;
-			c = 0;
-			int result;
-			result = _mm256_movemask_epi8(rf0);
-			if (result)
-			{
-				c = __builtin_popcount(result);
-				outlen += c*2;
-			}
-			outlen += 32-c;
-
-			//check 6 byte sequences
-			__m256i c5 = _mm256_set1_epi8('\x1f');
-			rf1 = _mm256_cmpgt_epi8(c3,chunk);
-			__m256i c6 = _mm256_set1_epi8('\x01');
-			rf2 = _mm256_cmpgt_epi8(chunk,c4);
-			rf0 = _mm256_and_si256(rf1, rf2); //final
-
-			c = 0;
-			result = _mm256_movemask_epi8(rf0);
-			if (result)
-			{
-				c = __builtin_popcount(result);
-				outlen += c*6;
-			}
-			outlen += 32-c;
-
-			resume_i+=32;
-
-#ifdef DEBUG
-			fprintf(stderr, "i=%d running multicore avx2 threadid=%d outlen=%zd\n",i,omp_get_thread_num(),outlen);
-#endif
-
-		}
+		static const char table[6] = {'b','t','n','v','f','r'};
+		out[0] = '\\';
+		out[1] = table[c-0x08];
+		return 2;
 	}
-#endif
-
-	if (resume_i)
-		resume_ii+=resume_i;
-	resume_i = 0;
-
-	if (outlen)
-		outlen_sum+=outlen;
-	outlen = 0;
-
-
-#ifdef DEBUG
-	fprintf(stderr, "before sse2 resume_i=%d outlen_sum=%zd\n",resume_i,outlen_sum);
-#endif
-	assert(outlen_sum>=resume_ii);
-
-	stop = 0;
-
-#ifdef __SSE2__
-	#pragma omp parallel for \
-		default(none) \
-		reduction(+:outlen,resume_i) \
-		shared(p,len,stderr) \
-		firstprivate(stop,resume_ii) \
-		private(i)
-	for (i = resume_ii; i < len; i+=16)
+	else if (c == '\"')
 	{
-		if (len-i <= 16)
-		{
-			stop = 1;
-		}
-
-		if (!stop)
-		{
-#ifdef DEBUG
-			fprintf(stderr, "i=%d running multicore sse2 threadid=%d\n", i, omp_get_thread_num());
-#endif
-
-			//compare 16 at a time instead of 1 at a time
-			__m128i chunk;
-			memcpy(&chunk, i+p, 16);
-			__m128i r0,r1,r2,r3,rf0,rf1,rf2,rf3;
-
-			//check 2 byte sequences
-			__m128i c0 = _mm_set1_epi8('\\'); //5c
-			__m128i c1 = _mm_set1_epi8('\"'); //22
-			__m128i c2 = _mm_set1_epi8('/'); //2f
-			r0 = _mm_cmpeq_epi8(chunk,c0); //x == backslash
-			r1 = _mm_cmpeq_epi8(chunk,c1); //x == "
-			r2 = _mm_cmpeq_epi8(chunk,c2); //x == .
-			rf0 = _mm_or_si128(r0,r1); // x == \\ || x == \"
-			rf0 = _mm_or_si128(rf0,r2); //final // x == \\ || x == \" || x == .
-
-			__m128i c3 = _mm_set1_epi8('\b'); //08
-			r0 = _mm_cmplt_epi8(c3,chunk); //\b < x
-			r1 = _mm_cmpeq_epi8(c3,chunk); //\b = x
-			rf1 = _mm_or_si128(r0,r1); //\b <= x
-			__m128i c4 = _mm_set1_epi8('\r'); //0d
-			r2 = _mm_cmplt_epi8(chunk,c4); //x < \r
-			r3 = _mm_cmpeq_epi8(chunk,c4); //x = \r
-			rf2 = _mm_or_si128(r2,r3); // x <= \r
-			rf3 = _mm_and_si128(rf1,rf2); //final \b <= x && x <= \r
-			rf0 = _mm_and_si128(rf0,rf3); //final
-
-			int c;
-			c = 0;
-			int result;
-			result = _mm_movemask_epi8(rf0);
-			if (result)
-			{
-				c = __builtin_popcount(result); //count bits set
-				outlen += c*2;
-#ifdef DEBUG
-				fprintf(stderr, "i=%d running multicore sse2 threadid=%d matches: c=%d result=%08x (2)\n", i, omp_get_thread_num(),c, result);
-#endif
-			}
-			outlen += 16-c;
-
-			//check 6 byte sequences
-			__m128i c5 = _mm_set1_epi8('\x01');
-			r0 = _mm_cmplt_epi8(c5,chunk); //\x01 < x
-			r1 = _mm_cmpeq_epi8(c5,chunk); //\x01 = x
-			rf1 = _mm_or_si128(r0,r1); // \x01 <= x
-			__m128i c6 = _mm_set1_epi8('\x1f');
-			r2 = _mm_cmplt_epi8(chunk,c6); //x < \x1f
-			r3 = _mm_cmpeq_epi8(chunk,c6); //x = \x1f
-			rf2 = _mm_or_si128(r2,r3); //x <= \x1f
-			rf0 = _mm_and_si128(rf1,rf2); //final \x01 <= x && x <= \x1f
-
-			c = 0;
-			result = _mm_movemask_epi8(rf0);
-			if (result)
-			{
-				c = __builtin_popcount(result);
-				outlen += c*6;
-#ifdef DEBUG
-				fprintf(stderr, "i=%d running multicore sse2 threadid=%d matches: c=%d result=%08x (3)\n", i, omp_get_thread_num(),c,result);
-#endif
-			}
-			outlen += 16-c;
-
-			resume_i+=16;
-		}
+		memcpy(out, "\\\"", 2);
+		return 2;
 	}
-#endif
-
-	if (resume_i)
-		resume_ii+=resume_i;
-	resume_i = 0;
-
-	if (outlen)
-		outlen_sum+=outlen;
-	outlen = 0;
-
-#ifdef DEBUG
-	//outlen_sum >= resume_ii
-	fprintf(stderr, "before mmx resume_ii=%d outlen_sum=%zd\n",resume_ii, outlen_sum);
-#endif
-	assert(outlen_sum>=resume_ii);
-
-	stop = 0;
-	int have_sse = ycmd_globals.have_sse;
-
-	//i = resume_i;
-#ifdef __MMX__
-	#pragma omp parallel for \
-		default(none) \
-		reduction(+:outlen,resume_i) \
-		shared(p,len,stderr,have_sse) \
-		firstprivate(stop,resume_ii) \
-		private(i)
-	for (i = resume_ii; i < len; i+=8)
+	else if (c == '/')
 	{
-		if (len-i <= 8)
-		{
-			stop = 1;
-		}
-
-		if (!stop)
-		{
-#ifdef DEBUG
-			fprintf(stderr, "i=%d running multicore mmx threadid=%d\n",i,omp_get_thread_num());
-#endif
-
-			//compare 8 at a time instead of 1
-
-			//mmx doesn't have cmplt < so we have to make a logical equivalent one using cmpgt >
-			//let c = 2
-			//1 <= c <= 3 which is equivalent to 1 <= c && c <= 3
-			//the logical equivalent one is
-			//3 >= c >= 1 which is equivalent to 3 >= c && c >= 1 check by subsituting c=2
-			//mmx
-			//_mm_cmpgt_pi8
-			//_mm_cmpeq_pi8
-			__m64 chunk;
-			memcpy(&chunk, i+p, 8);
-			__m64 r0,r1,r2,r3,rf0,rf1,rf2,rf3,rf4;
-
-			//check 2 byte sequences
-			__m64 c0 = _mm_set1_pi8('\\');
-			__m64 c1 = _mm_set1_pi8('\"');
-			__m64 c2 = _mm_set1_pi8('/');
-			r0 = _mm_cmpeq_pi8(chunk,c0);
-			r1 = _mm_cmpeq_pi8(chunk,c1);
-			r2 = _mm_cmpeq_pi8(chunk,c2);
-			rf0 = _mm_or_si64(r0,r1);
-			rf0 = _mm_or_si64(rf0,r2); //final
-
-
-			__m64 c3 = _mm_set1_pi8('\r'); //0d
-			r0 = _mm_cmpgt_pi8(c3,chunk);
-			r1 = _mm_cmpeq_pi8(c3,chunk);
-			rf1 = _mm_or_si64(r0,r1);
-			__m64 c4 = _mm_set1_pi8('\b'); //08
-			r2 = _mm_cmpgt_pi8(chunk,c4);
-			r3 = _mm_cmpeq_pi8(chunk,c4);
-			rf2 = _mm_or_si64(r2,r3);
-			rf3 = _mm_and_si64(rf1,rf2); //final
-			rf0 = _mm_or_si64(rf0,rf3); //final
-
-			int c;
-			int result;
-			if (have_sse)
-			{
-				c = 0;
-				result = _mm_movemask_pi8(rf0);
-				if (result)
-				{
-					c = __builtin_popcount(result);
-					outlen += c*2;
-#ifdef DEBUG
-					fprintf(stderr, "i=%d running multicore mmx threadid=%d matches: c=%d result=%04x (1)\n",i,omp_get_thread_num(),c, result);
-#endif
-				}
-				outlen += 8-c; //sizeof(mmx register) - hamming weight
-			}
-			else
-			{
-				//we need to extract a bit per each 8 byte block so we don't over count
-				c = 0;
-				int result_x;
-				result_x = _m_to_int(rf0);
-				result_x = (result_x & 0x01010101);
-				if (result_x)
-				{
-					c = __builtin_popcount(result_x);
-					outlen += c*2;
-#ifdef DEBUG
-					fprintf(stderr, "i=%d running multicore mmx threadid=%d matches: c=%d result_x=%04x (1a)\n",i,omp_get_thread_num(),c, result_x);
-#endif
-				}
-				outlen += 4-c; //sizeof((int32) low mmx register)) - hamming weight
-
-				c = 0;
-				rf0 = _m_psrlqi(rf0, 4);
-				result_x = _m_to_int(rf0);
-				result_x = (result_x & 0x01010101);
-				if (result_x)
-				{
-					c = __builtin_popcount(result_x);
-					outlen += c*2;
-#ifdef DEBUG
-					fprintf(stderr, "i=%d running multicore mmx threadid=%d matches: c=%d result_x=%04x (2)\n",i,omp_get_thread_num(),c, result_x);
-#endif
-				}
-				outlen += 4-c; //sizeof((int32) high mmx register)) - hamming weight
-			}
-
-			//check 6 byte sequences
-			__m64 c5 = _mm_set1_pi8('\x1f');
-			r0 = _mm_cmpgt_pi8(c5,chunk);
-			r1 = _mm_cmpeq_pi8(c5,chunk);
-			rf1 = _mm_or_si64(r0,r1);
-			__m64 c6 = _mm_set1_pi8('\x01');
-			r2 = _mm_cmpgt_pi8(chunk,c6);
-			r3 = _mm_cmpeq_pi8(chunk,c6);
-			rf2 = _mm_or_si64(r2,r3);
-			rf4 = _mm_and_si64(rf1,rf2); //final
-
-			if (have_sse)
-			{
-				c = 0;
-				result = _mm_movemask_pi8(rf4);
-				if (result)
-				{
-					c = __builtin_popcount(result);
-					outlen += c*2;
-#ifdef DEBUG
-					fprintf(stderr, "i=%d running multicore mmx threadid=%d matches: c=%d (1)\n",i,omp_get_thread_num(),c);
-#endif
-				}
-				outlen += 8-c;
-			}
-			else
-			{
-				//we need to extract a bit per each 8 byte block so we don't over count
-				c = 0;
-				int result_x;
-				result_x = _m_to_int(rf0);
-				result_x = (result_x & 0x01010101);
-				if (result_x)
-				{
-					c = __builtin_popcount(result_x);
-					outlen += c*6;
-#ifdef DEBUG
-					fprintf(stderr, "i=%d running multicore mmx threadid=%d matches: c=%d (1a)\n",i,omp_get_thread_num(),c);
-#endif
-				}
-				outlen += 4-c;
-
-				c = 0;
-				rf0 = _m_psrlqi(rf0, 4);
-				result_x = _m_to_int(rf0);
-				result_x = (result_x & 0x01010101);
-				if (result_x)
-				{
-					int c = __builtin_popcount(result_x);
-					outlen += c*6;
-#ifdef DEBUG
-					fprintf(stderr, "i=%d running multicore mmx threadid=%d matches: c=%d (2)\n",i,omp_get_thread_num(),c);
-#endif
-				}
-				outlen += 4-c;
-			}
-
-			resume_i+=8;
-
-#ifdef DEBUG
-			fprintf(stderr, "i=%d running multicore mmx threadid=%d outlen=%zd\n",i,omp_get_thread_num(),outlen);
-#endif
-		}
+		memcpy(out, "\\/", 2);
+		return 2;
 	}
-#endif
-
-	if (resume_i)
-		resume_ii+=resume_i;
-	resume_i = 0;
-
-	if (outlen)
-		outlen_sum+=outlen;
-	outlen = 0;
-
-#ifdef DEBUG
-	fprintf(stderr, "before naive resume_ii=%d outlen_sum=%zd\n",resume_ii, outlen_sum);
-#endif
-	assert(outlen_sum>=resume_ii);
-
-	#pragma omp parallel for \
-		default(none) \
-		reduction(+:outlen,resume_i) \
-		shared(p,len,stderr) \
-		firstprivate(stop,resume_ii) \
-		private(i)
-	for (i = resume_ii; i < len; i++)
+	else if (('\x01' <= c && c <= '\x1f') /* || p[i] == 0x7f delete char */) //escape control characters
 	{
-
-#ifdef DEBUG
-		fprintf(stderr, "i=%d running multicore byte checks threadid=%d\n",i,omp_get_thread_num());
-#endif
-		int matches = 0;
-		char c = p[i];
-		if (c == '\\' || ('\b' <= c && c <= '\r') || c == '\"' || c == '/') // \\   //escape already escape
-		{
-			outlen+=2;
-			matches+=1;
-		}
-		else if (('\x01' <= c && c <= '\x1f') /* || p[i] == 0x7f delete char */) //escape control characters
-		{
-			outlen+=6;
-			matches+=1;
-		}
-		else
-		{
-			outlen+=1;
-			matches+=1;
-		}
-
-#ifdef DEBUG
-		fprintf(stderr, "i=%d running multicore byte checks threadid=%d matches=%d\n",i,omp_get_thread_num(),matches);
-#endif
-		resume_i+=1;
+		memcpy(out, "\\u00", 4);
+		out[4] = hex[(c >> 4) & 0x0f];
+		out[5] = hex[c & 0x0f];
+		return 6;
+	}
+	else
+	{
+		out[0] = c;
+		return 1;
 	}
-
-	if (resume_i)
-		resume_ii+=resume_i;
-
-	if (outlen)
-		outlen_sum+=outlen;
-
-#ifdef DEBUG
-	fprintf(stderr, "final resume_ii=%d\n",resume_ii);
-#endif
-
-#ifdef DEBUG
-	fprintf(stderr, "final length=%zd\n",outlen_sum);
-#endif
-
-	assert(outlen_sum>=resume_ii);
-
-	return outlen_sum;
 }
-#endif
 
 //naive version for unicore and non simd
 //scopes out the new length so we can avoid the overhead of many calls to _expand or realloc
@@ -4611,24 +4192,69 @@ size_t _predict_new_json_escape_size_naive(char **buffer)
 
 	char *p = *buffer;
 	for (i = 0; i < len; i++)
+		outlen += _json_escape_width(p[i]);
+
+	return outlen;
+}
+
+#if USE_OPENMP
+//the buffer is split into one chunk per thread.  each thread measures the escaped length of its own chunk,
+//then a prefix sum over those lengths gives every thread the offset where its chunk goes in the output.
+//all threads then write into the same preallocated output at the same time without any locking.
+char *_escape_json_multicore(char *p, size_t len)
+{
+	char *out = NULL;
+	size_t *offsets = NULL;
+	int nchunks = 0;
+
+	#pragma omp parallel \
+		default(none) \
+		shared(p,len,out,offsets,nchunks,stderr)
 	{
-		char c = p[i];
-		if (c == '\\' || ('\b' <= c && c <= '\r') || c == '\"' || c == '/') // \\   //escape already escape
-		{
-			outlen+=2;
-		}
-		else if (('\x01' <= c && c <= '\x1f') /* || p[i] == 0x7f delete char */) //escape control characters
+		int tid = omp_get_thread_num();
+
+		#pragma omp single
 		{
-			outlen+=6;
+			nchunks = omp_get_num_threads();
+			offsets = calloc(nchunks+1, sizeof(size_t));
 		}
-		else
+		//implicit barrier: offsets is ready
+
+		size_t start = len * tid / nchunks;
+		size_t end = len * (tid+1) / nchunks;
+		size_t chunk_length = 0;
+		size_t i;
+
+		for (i = start; i < end; i++)
+			chunk_length += _json_escape_width(p[i]);
+		offsets[tid+1] = chunk_length;
+
+		#pragma omp barrier
+
+		#pragma omp single
 		{
-			outlen++;
+			int t;
+			for (t = 1; t <= nchunks; t++)
+				offsets[t] += offsets[t-1];
+			out = malloc(offsets[nchunks]+1);
+			out[offsets[nchunks]] = 0;
 		}
+		//implicit barrier: out and the prefix sums are ready
+
+#ifdef DEBUG
+		fprintf(stderr, "escape_json chunk [%zd,%zd) -> offset %zd running threadid=%d\n",start,end,offsets[tid],tid);
+#endif
+
+		char *q = out + offsets[tid];
+		for (i = start; i < end; i++)
+			q += _json_escape_char(p[i], q);
 	}
 
-	return outlen;
+	free(offsets);
+
+	return out;
 }
+#endif
 
 //gprof reports this function takes 33% time
 //we don't use simd because the distance between collisions for the head of the sequence is very short with high probability so register size transfers via sse/avx for headless marked segments are rare
@@ -4640,63 +4266,25 @@ void escape_json(char **buffer)
 	int i = 0;
 	int len = strlen(*buffer);
 	char *out;
-
-	size_t new_length;
+	char *p = *buffer;
 
 #if USE_OPENMP
 	if (ycmd_globals.cpu_cores > 1)
-		new_length = _predict_new_json_escape_size_multicore(buffer);
-	else
+	{
+		*buffer = _escape_json_multicore(p, len);
+		free(p);
+		return;
+	}
 #endif
-		new_length = _predict_new_json_escape_size_naive(buffer);
+
+	size_t new_length = _predict_new_json_escape_size_naive(buffer);
 
 	out = malloc(new_length);
 	out[0] = '\0';
 
 	int j = 0;
-	char *p = *buffer;
 	for (i = 0; i < len; i++)
-	{
-		char c = p[i];
-		//reduce the number of comparisons because switch case in assembly is just test jump statements
-		//the original had 34 case statements so 34 test instructions... currently have 9 test instructions with the if/else chain
-		if (c == '\\') // \\   //escape already escape
-		{
-			memcpy(out+j, "\\\\", 2);
-			j+=2;
-		}
-		else if ('\b' <= c && c <= '\r') // c escape sequences
-		{
-			char table[6] = {'b','t','n','v','f','r'};
-			char tbuf[3];
-			sprintf(tbuf, "\\%c", table[p[i]-0x08]);
-			memcpy(out+j, tbuf, 2);
-			j+=2;
-
-		}
-		else if (c == '\"')
-		{
-			memcpy(out+j, "\\\"", 2);
-			j+=2;
-		}
-		else if (c == '/')
-		{
-			memcpy(out+j, "\\/", 2);
-			j+=2;
-
-		}
-		else if (('\x01' <= c && c <= '\x1f') /* || p[i] == 0x7f delete char */) //escape control characters
-		{
-			char tbuf[8];
-			sprintf(tbuf, "\\u00%02x", c);
-			memcpy(out+j, tbuf, 6);
-			j+=6;
-		}
-		else
-		{
-			out[j++] = c;
-		}
-	}
+		j += _json_escape_char(p[i], out+j);
 	out[j] = 0;
 
 	*buffer=out;
@@ -5733,7 +5321,18 @@ void ycmd_event_file_ready_to_parse(int columnnum, int linenum, char *filepath,
 			ycmd_req_load_extra_conf_file(path_extra_conf);
 #endif
 		}
-		ycmd_json_event_notification(columnnum, linenum, filepath, "FileReadyToParse", content);
+
+		//the server already parsed this exact version of the buffer so only ask for completions
+		openfilestruct *buffer = _ycmd_find_buffer(filetop);
+		if (buffer && buffer->version == buffer->ycmd_parsed_version)
+		{
+#ifdef DEBUG
+			fprintf(stderr,"Skipping FileReadyToParse for unchanged version %zd\n", buffer->version);
+#endif
+		}
+		else if (ycmd_json_event_notification(columnnum, linenum, filepath, "FileReadyToParse", content) && buffer)
+			buffer->ycmd_parsed_version = buffer->version;
+
 		ycmd_req_completions_suggestions(linenum, columnnum, filepath, content, "filetype_default");
 		if (is_c_family(ft))
 			ycmd_req_ignore_extra_conf_file(path_extra_conf);
@@ -6103,7 +5702,7 @@ void do_completer_command_show(void)
 	//should cache
 	DEFINED_SUBCOMMANDS_RESULTS dsr;
 	init_defined_subcommands_results(&dsr);
-	ycmd_req_defined_subcommands((long)openfile->current->lineno, openfile->current_x, openfile->filename, content, ft, &dsr);
+	ycmd_req_defined_subcommands((long)lineno_of(openfile->current), openfile->current_x, openfile->filename, content, ft, &dsr);
 	//should return something like: ["ClearCompilationFlagCache", "FixIt", "GetDoc", "GetDocImprecise", "GetParent", "GetType", "GetTypeImprecise", "GoTo", "GoToDeclaration", "GoToDefinition", "GoToImprecise", "GoToInclude"]
 
 	if (dsr.usable && dsr.status_code == 200)